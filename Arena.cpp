@@ -0,0 +1,72 @@
+// ==========================================================================
+// Arena Allocation
+// ==========================================================================
+
+#include "Arena.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+MyArena::~MyArena()
+{
+    for (size_t i = 0; i < blocks.size(); i++)
+        delete[] blocks[i];
+}
+
+void *ArenaAllocate(MyArena *arena, size_t bytes, size_t align)
+{
+    lock_guard<mutex> guard(arena->lock);
+
+    while (true)
+    {
+        if (arena->current < arena->blocks.size())
+        {
+            size_t start = (arena->used + align - 1) & ~(align - 1);
+            if (start + bytes <= arena->sizes[arena->current])
+            {
+                arena->live += start + bytes - arena->used;
+                arena->peak = max(arena->peak, arena->live);
+                arena->used = start + bytes;
+                return arena->blocks[arena->current] + start;
+            }
+
+            // move on to the next block kept from an earlier scope
+            arena->live += arena->sizes[arena->current] - arena->used;
+            arena->current++;
+            arena->used = 0;
+            if (arena->current < arena->blocks.size())
+                continue;
+        }
+
+        // out of blocks: grow by one large enough for this allocation
+        size_t size = max(arena->blockSize, bytes + align);
+        arena->blocks.push_back(new char[size]);
+        arena->sizes.push_back(size);
+        arena->current = arena->blocks.size() - 1;
+        arena->used = 0;
+    }
+}
+
+void ResetArena(MyArena *arena)
+{
+    lock_guard<mutex> guard(arena->lock);
+    arena->current = 0;
+    arena->used = 0;
+    arena->live = 0;
+}
+
+size_t ArenaPeak(const MyArena *arena)
+{
+    return arena->peak;
+}
+
+size_t ArenaReserved(const MyArena *arena)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < arena->sizes.size(); i++)
+        total += arena->sizes[i];
+    return total;
+}
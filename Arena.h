@@ -0,0 +1,108 @@
+// ==========================================================================
+// Arena Allocation
+//  - bump allocation for data that lives only as long as one layout or frame
+//
+// An arena hands out memory by advancing a cursor through large blocks and
+// never frees individual allocations. Resetting it ends the scope: the
+// cursor returns to the first block and every block is kept for the next
+// scope, so once the arena has grown to its peak size a scope makes no heap
+// allocations at all. Allocation takes a lock, so jobs running on several
+// threads may share one arena.
+//
+// MyArenaAllocator lets standard containers draw from an arena; one built
+// without an arena falls back to the heap.
+// ==========================================================================
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// --------------------------------------------------------------------------
+
+struct MyArena
+{
+    // blocks owned by the arena and their sizes, the block being allocated
+    // from and the bytes used in it
+    std::vector<char *> blocks;
+    std::vector<size_t> sizes;
+    size_t              current;
+    size_t              used;
+
+    // bytes handed out in this scope, and the most in any scope
+    size_t              live;
+    size_t              peak;
+
+    // default size of a new block
+    size_t              blockSize;
+
+    std::mutex          lock;
+
+    MyArena(size_t block = 1 << 20)
+        : current(0), used(0), live(0), peak(0), blockSize(block)
+    {}
+    ~MyArena();
+};
+
+// returns bytes of memory aligned to align (a power of two) from the arena
+void *ArenaAllocate(MyArena *arena, size_t bytes, size_t align);
+
+// ends the current scope, keeping every block for reuse
+void ResetArena(MyArena *arena);
+
+// largest number of bytes in use at once, and total bytes reserved in blocks
+size_t ArenaPeak(const MyArena *arena);
+size_t ArenaReserved(const MyArena *arena);
+
+// --------------------------------------------------------------------------
+// Standard allocator drawing from an arena
+
+template <typename T>
+struct MyArenaAllocator
+{
+    typedef T value_type;
+
+    MyArena *arena;
+
+    MyArenaAllocator(MyArena *a = 0) : arena(a)
+    {}
+
+    template <typename U>
+    MyArenaAllocator(const MyArenaAllocator<U> &other) : arena(other.arena)
+    {}
+
+    T *allocate(size_t n)
+    {
+        if (!arena)
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        return static_cast<T *>(ArenaAllocate(arena, n * sizeof(T), alignof(T)));
+    }
+
+    // arena memory is only released when the arena is reset
+    void deallocate(T *p, size_t)
+    {
+        if (!arena)
+            ::operator delete(p);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const MyArenaAllocator<T> &a, const MyArenaAllocator<U> &b)
+{
+    return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const MyArenaAllocator<T> &a, const MyArenaAllocator<U> &b)
+{
+    return a.arena != b.arena;
+}
+
+// a vector whose storage comes from an arena
+template <typename T>
+using ArenaVector = std::vector<T, MyArenaAllocator<T> >;
+
+// --------------------------------------------------------------------------
+#endif // ARENA_H
@@ -0,0 +1,603 @@
+// ==========================================================================
+// Native CFF Outline Reader
+// ==========================================================================
+
+#include "Cff.h"
+#include "TrueType.h"
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+// limits set by the Type 2 charstring format
+const int MAX_STACK = 48;
+const int MAX_SUBR_DEPTH = 10;
+
+// one is 1 << 16 in the 16.16 fixed point the pen is kept in
+const int FIXED_SHIFT = 16;
+
+unsigned int Read16(const unsigned char *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+// reads an INDEX structure at offset, recording the byte range of each of
+// its entries and where the data after it begins
+bool ReadIndex(const unsigned char *data, size_t size, size_t offset,
+               vector<MyCffRange> *ranges, size_t *next)
+{
+    ranges->clear();
+    if (offset + 2 > size) return false;
+    unsigned int count = Read16(data + offset);
+    if (count == 0) {
+        *next = offset + 2;
+        return true;
+    }
+
+    if (offset + 3 > size) return false;
+    int offSize = data[offset + 2];
+    if (offSize < 1 || offSize > 4) return false;
+    size_t offsets = offset + 3;
+    if (offsets + size_t(count + 1) * offSize > size) return false;
+
+    // offsets count from 1, from the byte before the data
+    size_t base = offsets + size_t(count + 1) * offSize - 1;
+    size_t previous = 0;
+    ranges->resize(count);
+    for (unsigned int i = 0; i <= count; ++i)
+    {
+        size_t value = 0;
+        for (int b = 0; b < offSize; ++b)
+            value = (value << 8) | data[offsets + i * offSize + b];
+        if (value < 1 || base + value > size || (i > 0 && value < previous)) return false;
+
+        if (i > 0) (*ranges)[i - 1].end = base + value;
+        if (i < count) (*ranges)[i].begin = base + value;
+        previous = value;
+    }
+    *next = base + previous;
+    return true;
+}
+
+// the entries of a top, font or private DICT that outlines depend on
+struct DictValues
+{
+    long charStrings, fdArray, fdSelect;
+    long privateSize, privateOffset;
+    long subrs;
+    long charstringType;
+    bool cid;
+
+    DictValues()
+        : charStrings(-1), fdArray(-1), fdSelect(-1), privateSize(-1), privateOffset(-1),
+          subrs(-1), charstringType(2), cid(false)
+    {}
+};
+
+bool ReadDict(const unsigned char *data, size_t begin, size_t end, DictValues *values)
+{
+    long operands[48];
+    int count = 0;
+
+    size_t i = begin;
+    while (i < end)
+    {
+        int b0 = data[i++];
+        long value;
+        if (b0 >= 32 && b0 <= 246) value = b0 - 139;
+        else if (b0 >= 247 && b0 <= 254)
+        {
+            if (i >= end) return false;
+            int b1 = data[i++];
+            value = (b0 <= 250) ? (b0 - 247) * 256 + b1 + 108 : -(b0 - 251) * 256 - b1 - 108;
+        }
+        else if (b0 == 28)
+        {
+            if (i + 2 > end) return false;
+            value = short(Read16(data + i));
+            i += 2;
+        }
+        else if (b0 == 29)
+        {
+            if (i + 4 > end) return false;
+            value = int((Read16(data + i) << 16) | Read16(data + i + 2));
+            i += 4;
+        }
+        else if (b0 == 30)
+        {
+            // real numbers are never offsets, so their nibbles are skipped
+            while (i < end && (data[i] & 0x0F) != 0x0F && (data[i] & 0xF0) != 0xF0) ++i;
+            if (i++ >= end) return false;
+            value = 0;
+        }
+        else
+        {
+            // an operator, which consumes the operands before it
+            int op = b0;
+            if (b0 == 12) {
+                if (i >= end) return false;
+                op = 1200 + data[i++];
+            }
+
+            if (op == 17 && count >= 1) values->charStrings = operands[count - 1];
+            else if (op == 18 && count >= 2) {
+                values->privateSize = operands[count - 2];
+                values->privateOffset = operands[count - 1];
+            }
+            else if (op == 19 && count >= 1) values->subrs = operands[count - 1];
+            else if (op == 1206 && count >= 1) values->charstringType = operands[count - 1];
+            else if (op == 1230) values->cid = true;
+            else if (op == 1236 && count >= 1) values->fdArray = operands[count - 1];
+            else if (op == 1237 && count >= 1) values->fdSelect = operands[count - 1];
+
+            count = 0;
+            continue;
+        }
+
+        if (count == 48) return false;
+        operands[count++] = value;
+    }
+    return true;
+}
+
+// reads a private DICT and the local subroutines it points to
+bool ReadPrivate(const unsigned char *data, size_t size, const DictValues &dict,
+                 vector<MyCffRange> *subrs)
+{
+    subrs->clear();
+    if (dict.privateOffset < 0 || dict.privateSize < 0) return true;
+    if (size_t(dict.privateOffset) + dict.privateSize > size) return false;
+
+    size_t begin = dict.privateOffset;
+    DictValues values;
+    if (!ReadDict(data, begin, begin + dict.privateSize, &values)) return false;
+
+    // the subroutine offset counts from the start of the private DICT
+    size_t next;
+    if (values.subrs > 0 && !ReadIndex(data, size, begin + values.subrs, subrs, &next))
+        return false;
+    return true;
+}
+
+// bias added to subroutine numbers, which depends on how many there are
+int SubrBias(size_t count)
+{
+    if (count < 1240) return 107;
+    if (count < 33900) return 1131;
+    return 32768;
+}
+
+// --------------------------------------------------------------------------
+// Type 2 charstring interpretation
+
+struct CharString
+{
+    MyTrueTypeFont *font;
+    const unsigned char *data;
+    const vector<MyCffRange> *localSubrs;
+
+    long stack[MAX_STACK];
+    int top;
+
+    // pen position in 16.16 fixed point
+    long x, y;
+
+    int stems;
+    bool widthDone;
+    bool open;
+    bool ended;
+
+    // index of the first point of the open contour
+    size_t first;
+};
+
+void AddPoint(CharString *state, long x, long y, MyOutlineTag tag)
+{
+    FT_Vector point;
+    point.x = x >> FIXED_SHIFT;
+    point.y = y >> FIXED_SHIFT;
+    state->font->points.push_back(point);
+    state->font->tags.push_back(tag);
+}
+
+// ends the open contour the way FreeType does: a closing point on top of the
+// first is dropped, and so is a contour left with a single point
+void CloseContour(CharString *state)
+{
+    if (!state->open) return;
+    state->open = false;
+
+    MyTrueTypeFont *font = state->font;
+    size_t last = font->points.size() - 1;
+    if (last > state->first &&
+        font->points[last].x == font->points[state->first].x &&
+        font->points[last].y == font->points[state->first].y &&
+        font->tags[last] == FT_CURVE_TAG_ON)
+    {
+        font->points.pop_back();
+        font->tags.pop_back();
+        --last;
+    }
+
+    if (last == state->first) {
+        font->points.pop_back();
+        font->tags.pop_back();
+        font->contours.pop_back();
+    }
+    else font->contours.back() = last;
+}
+
+// a contour begins at the moveto point, but only once something is drawn
+void StartContour(CharString *state)
+{
+    if (state->open) return;
+    state->open = true;
+    state->first = state->font->points.size();
+    state->font->contours.push_back(state->first);
+    AddPoint(state, state->x, state->y, FT_CURVE_TAG_ON);
+}
+
+void MoveTo(CharString *state, long dx, long dy)
+{
+    CloseContour(state);
+    state->x += dx;
+    state->y += dy;
+}
+
+void LineTo(CharString *state, long dx, long dy)
+{
+    // FreeType drops lines of no length once a contour has begun
+    if (dx == 0 && dy == 0 && state->open) return;
+
+    StartContour(state);
+    state->x += dx;
+    state->y += dy;
+    AddPoint(state, state->x, state->y, FT_CURVE_TAG_ON);
+}
+
+void CurveTo(CharString *state, long dx1, long dy1, long dx2, long dy2, long dx3, long dy3)
+{
+    StartContour(state);
+    long x1 = state->x + dx1, y1 = state->y + dy1;
+    long x2 = x1 + dx2, y2 = y1 + dy2;
+    state->x = x2 + dx3;
+    state->y = y2 + dy3;
+    AddPoint(state, x1, y1, FT_CURVE_TAG_CUBIC);
+    AddPoint(state, x2, y2, FT_CURVE_TAG_CUBIC);
+    AddPoint(state, state->x, state->y, FT_CURVE_TAG_ON);
+}
+
+// the first operator that clears the stack may carry the glyph width as an
+// extra first operand, which is not needed since hmtx has the advance
+int SkipWidth(CharString *state, bool extra)
+{
+    if (state->widthDone) return 0;
+    state->widthDone = true;
+    return extra ? 1 : 0;
+}
+
+bool Execute(CharString *state, const MyCffRange &range, int depth)
+{
+    if (depth > MAX_SUBR_DEPTH) return false;
+
+    const unsigned char *at = state->data + range.begin;
+    const unsigned char *end = state->data + range.end;
+    long *s = state->stack;
+
+    while (at < end)
+    {
+        int b0 = *at++;
+
+        // operands, kept in 16.16 fixed point
+        if (b0 >= 32 || b0 == 28)
+        {
+            long value;
+            if (b0 <= 246 && b0 != 28) value = b0 - 139;
+            else if (b0 <= 254 && b0 != 28)
+            {
+                if (at >= end) return false;
+                int b1 = *at++;
+                value = (b0 <= 250) ? (b0 - 247) * 256 + b1 + 108 : -(b0 - 251) * 256 - b1 - 108;
+            }
+            else if (b0 == 28)
+            {
+                if (at + 2 > end) return false;
+                value = short(Read16(at));
+                at += 2;
+            }
+            else
+            {
+                if (at + 4 > end) return false;
+                long fixed = int((Read16(at) << 16) | Read16(at + 2));
+                at += 4;
+                if (state->top == MAX_STACK) return false;
+                s[state->top++] = fixed;
+                continue;
+            }
+            if (state->top == MAX_STACK) return false;
+            s[state->top++] = value * (1L << FIXED_SHIFT);
+            continue;
+        }
+
+        int top = state->top;
+        int i = 0;
+        switch (b0)
+        {
+        case 1:     // hstem
+        case 3:     // vstem
+        case 18:    // hstemhm
+        case 23:    // vstemhm
+            i = SkipWidth(state, top % 2 == 1);
+            state->stems += (top - i) / 2;
+            break;
+
+        case 19:    // hintmask
+        case 20:    // cntrmask
+            // operands left here are an implied vstem
+            i = SkipWidth(state, top % 2 == 1);
+            state->stems += (top - i) / 2;
+            at += (state->stems + 7) / 8;
+            if (at > end) return false;
+            break;
+
+        case 21:    // rmoveto
+            i = SkipWidth(state, top > 2);
+            if (top - i < 2) return false;
+            MoveTo(state, s[i], s[i + 1]);
+            break;
+
+        case 22:    // hmoveto
+            i = SkipWidth(state, top > 1);
+            if (top - i < 1) return false;
+            MoveTo(state, s[i], 0);
+            break;
+
+        case 4:     // vmoveto
+            i = SkipWidth(state, top > 1);
+            if (top - i < 1) return false;
+            MoveTo(state, 0, s[i]);
+            break;
+
+        case 5:     // rlineto
+            for (; i + 2 <= top; i += 2)
+                LineTo(state, s[i], s[i + 1]);
+            break;
+
+        case 6:     // hlineto
+        case 7:     // vlineto
+        {
+            bool horizontal = (b0 == 6);
+            for (; i < top; ++i, horizontal = !horizontal)
+            {
+                if (horizontal) LineTo(state, s[i], 0);
+                else LineTo(state, 0, s[i]);
+            }
+            break;
+        }
+
+        case 8:     // rrcurveto
+            for (; i + 6 <= top; i += 6)
+                CurveTo(state, s[i], s[i + 1], s[i + 2], s[i + 3], s[i + 4], s[i + 5]);
+            break;
+
+        case 24:    // rcurveline
+            for (; i + 8 <= top; i += 6)
+                CurveTo(state, s[i], s[i + 1], s[i + 2], s[i + 3], s[i + 4], s[i + 5]);
+            if (i + 2 > top) return false;
+            LineTo(state, s[i], s[i + 1]);
+            break;
+
+        case 25:    // rlinecurve
+            for (; i + 8 <= top; i += 2)
+                LineTo(state, s[i], s[i + 1]);
+            if (i + 6 > top) return false;
+            CurveTo(state, s[i], s[i + 1], s[i + 2], s[i + 3], s[i + 4], s[i + 5]);
+            break;
+
+        case 26:    // vvcurveto
+        {
+            long dx1 = 0;
+            if (top % 2 == 1) dx1 = s[i++];
+            for (; i + 4 <= top; i += 4, dx1 = 0)
+                CurveTo(state, dx1, s[i], s[i + 1], s[i + 2], 0, s[i + 3]);
+            break;
+        }
+
+        case 27:    // hhcurveto
+        {
+            long dy1 = 0;
+            if (top % 2 == 1) dy1 = s[i++];
+            for (; i + 4 <= top; i += 4, dy1 = 0)
+                CurveTo(state, s[i], dy1, s[i + 1], s[i + 2], s[i + 3], 0);
+            break;
+        }
+
+        case 30:    // vhcurveto
+        case 31:    // hvcurveto
+        {
+            bool horizontal = (b0 == 31);
+            for (; i + 4 <= top; i += 4, horizontal = !horizontal)
+            {
+                // the last curve may end off the axis
+                long last = (top - i == 5) ? s[i + 4] : 0;
+                if (horizontal)
+                    CurveTo(state, s[i], 0, s[i + 1], s[i + 2], last, s[i + 3]);
+                else
+                    CurveTo(state, 0, s[i], s[i + 1], s[i + 2], s[i + 3], last);
+            }
+            break;
+        }
+
+        case 10:    // callsubr
+        case 29:    // callgsubr
+        {
+            if (top < 1) return false;
+            const vector<MyCffRange> &subrs = (b0 == 10) ? *state->localSubrs
+                                                         : state->font->cff.globalSubrs;
+            long number = (s[--state->top] >> FIXED_SHIFT) + SubrBias(subrs.size());
+            if (number < 0 || size_t(number) >= subrs.size()) return false;
+            if (!Execute(state, subrs[number], depth + 1)) return false;
+            if (state->ended) return true;
+            continue;
+        }
+
+        case 11:    // return
+            return true;
+
+        case 14:    // endchar
+            // four operands left make an accented character, not handled
+            i = SkipWidth(state, top == 1 || top == 5);
+            if (top - i != 0) return false;
+            CloseContour(state);
+            state->ended = true;
+            return true;
+
+        case 12:
+        {
+            if (at >= end) return false;
+            int op = *at++;
+            if (op == 35)           // flex
+            {
+                if (top < 13) return false;
+                CurveTo(state, s[0], s[1], s[2], s[3], s[4], s[5]);
+                CurveTo(state, s[6], s[7], s[8], s[9], s[10], s[11]);
+            }
+            else if (op == 34)      // hflex
+            {
+                if (top < 7) return false;
+                CurveTo(state, s[0], 0, s[1], s[2], s[3], 0);
+                CurveTo(state, s[4], 0, s[5], -s[2], s[6], 0);
+            }
+            else if (op == 36)      // hflex1
+            {
+                if (top < 9) return false;
+                CurveTo(state, s[0], s[1], s[2], s[3], s[4], 0);
+                CurveTo(state, s[5], 0, s[6], s[7], s[8], -(s[1] + s[3] + s[7]));
+            }
+            else if (op == 37)      // flex1
+            {
+                if (top < 11) return false;
+                long dx = s[0] + s[2] + s[4] + s[6] + s[8];
+                long dy = s[1] + s[3] + s[5] + s[7] + s[9];
+                bool horizontal = (dx < 0 ? -dx : dx) > (dy < 0 ? -dy : dy);
+                CurveTo(state, s[0], s[1], s[2], s[3], s[4], s[5]);
+                CurveTo(state, s[6], s[7], s[8], s[9],
+                        horizontal ? s[10] : -dx, horizontal ? -dy : s[10]);
+            }
+            else return false;
+            break;
+        }
+
+        default:
+            return false;
+        }
+
+        state->top = 0;
+    }
+
+    return true;
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+bool OpenCffTable(MyTrueTypeFont *font, size_t table, size_t length)
+{
+    MyCffFont &cff = font->cff;
+    const unsigned char *data = font->data + table;
+    cff.table = table;
+    cff.length = length;
+
+    // header, then the name, top DICT, string and global subroutine INDEXes
+    if (length < 4 || data[0] != 1) return false;
+    size_t next = data[2];
+    vector<MyCffRange> names, topDicts, strings;
+    if (!ReadIndex(data, length, next, &names, &next) ||
+        !ReadIndex(data, length, next, &topDicts, &next) || topDicts.empty() ||
+        !ReadIndex(data, length, next, &strings, &next) ||
+        !ReadIndex(data, length, next, &cff.globalSubrs, &next))
+        return false;
+
+    DictValues top;
+    if (!ReadDict(data, topDicts[0].begin, topDicts[0].end, &top)) return false;
+    if (top.charstringType != 2 || top.charStrings < 0) return false;
+    if (!ReadIndex(data, length, top.charStrings, &cff.charStrings, &next)) return false;
+
+    cff.localSubrs.clear();
+    cff.fdSelect.clear();
+    if (!top.cid)
+    {
+        cff.localSubrs.resize(1);
+        return ReadPrivate(data, length, top, &cff.localSubrs[0]);
+    }
+
+    // CID-keyed fonts have a font dict, with its own private DICT, for each
+    // group of glyphs
+    vector<MyCffRange> fontDicts;
+    if (top.fdArray < 0 || top.fdSelect < 0 ||
+        !ReadIndex(data, length, top.fdArray, &fontDicts, &next) || fontDicts.empty())
+        return false;
+    cff.localSubrs.resize(fontDicts.size());
+    for (size_t f = 0; f < fontDicts.size(); ++f)
+    {
+        DictValues dict;
+        if (!ReadDict(data, fontDicts[f].begin, fontDicts[f].end, &dict) ||
+            !ReadPrivate(data, length, dict, &cff.localSubrs[f]))
+            return false;
+    }
+
+    size_t glyphCount = cff.charStrings.size();
+    size_t at = top.fdSelect;
+    if (at >= length) return false;
+    int format = data[at++];
+    cff.fdSelect.assign(glyphCount, 0);
+    if (format == 0)
+    {
+        if (at + glyphCount > length) return false;
+        cff.fdSelect.assign(data + at, data + at + glyphCount);
+    }
+    else if (format == 3)
+    {
+        if (at + 2 > length) return false;
+        unsigned int rangeCount = Read16(data + at);
+        at += 2;
+        if (at + 3 * size_t(rangeCount) + 2 > length) return false;
+        for (unsigned int r = 0; r < rangeCount; ++r, at += 3)
+        {
+            unsigned int first = Read16(data + at);
+            unsigned int last = Read16(data + at + 3);
+            for (unsigned int g = first; g < last && g < glyphCount; ++g)
+                cff.fdSelect[g] = data[at + 2];
+        }
+    }
+    else return false;
+
+    for (size_t g = 0; g < glyphCount; ++g)
+        if (cff.fdSelect[g] >= fontDicts.size()) return false;
+    return true;
+}
+
+bool LoadCffGlyph(MyTrueTypeFont *font, unsigned int glyphIndex)
+{
+    const MyCffFont &cff = font->cff;
+    if (glyphIndex >= cff.charStrings.size()) return false;
+
+    CharString state;
+    state.font = font;
+    state.data = font->data + cff.table;
+    state.localSubrs = &cff.localSubrs[cff.fdSelect.empty() ? 0 : cff.fdSelect[glyphIndex]];
+    state.top = 0;
+    state.x = state.y = 0;
+    state.stems = 0;
+    state.widthDone = false;
+    state.open = false;
+    state.ended = false;
+    state.first = 0;
+
+    if (!Execute(&state, cff.charStrings[glyphIndex], 0)) return false;
+    CloseContour(&state);
+    return true;
+}
@@ -0,0 +1,57 @@
+// ==========================================================================
+// Native CFF Outline Reader
+//  - interprets the Type 2 charstrings of fonts with CFF outlines
+//
+// The CFF table of an OpenType font is read from the mapped font file. When
+// the font opens, the INDEX structures of its charstrings and of its global
+// and local subroutines are decoded once into tables of byte ranges, so that
+// calling a subroutine costs a table lookup instead of a walk through its
+// INDEX. Charstrings are then run by a small interpreter that keeps the pen
+// in 16.16 fixed point, as FreeType does, ignores hints, and emits cubic
+// outlines in font units into the outline arrays of an MyTrueTypeFont.
+// Charstrings that use the rarely seen arithmetic operators or the old
+// accented character form of endchar are refused, and left to FreeType.
+// ==========================================================================
+#ifndef CFF_H
+#define CFF_H
+
+#include <cstddef>
+#include <vector>
+
+struct MyTrueTypeFont;
+
+// --------------------------------------------------------------------------
+
+// the bytes of one charstring or subroutine, as offsets into the CFF table
+struct MyCffRange
+{
+    unsigned int begin, end;
+};
+
+struct MyCffFont
+{
+    // offset and length of the CFF table in the font file, or 0 if none
+    size_t table, length;
+
+    std::vector<MyCffRange> charStrings;
+    std::vector<MyCffRange> globalSubrs;
+
+    // local subroutines of each font dict, and the font dict of each glyph
+    // in CID-keyed fonts, which is empty for fonts with a single dict
+    std::vector<std::vector<MyCffRange> > localSubrs;
+    std::vector<unsigned char> fdSelect;
+
+    MyCffFont() : table(0), length(0)
+    {}
+};
+
+// reads the CFF table at the given place in the font's file, returning false
+// if it is malformed or of a kind not handled here
+bool OpenCffTable(MyTrueTypeFont *font, size_t table, size_t length);
+
+// runs the charstring of a glyph into the font's outline arrays, returning
+// false if it is malformed or uses an operator not handled here
+bool LoadCffGlyph(MyTrueTypeFont *font, unsigned int glyphIndex);
+
+// --------------------------------------------------------------------------
+#endif // CFF_H
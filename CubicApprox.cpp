@@ -0,0 +1,123 @@
+// ==========================================================================
+// Cubic to Quadratic Approximation
+// ==========================================================================
+
+#include "CubicApprox.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+// samples per quadratic when checking an approximation
+const int CHECK_SAMPLES = 8;
+
+// point at parameter t on a Bezier segment of degree 2 or 3
+void Evaluate(const MySegment &segment, float t, float *x, float *y)
+{
+    float s = 1 - t;
+    if (segment.degree == 3)
+    {
+        float a = s * s * s, b = 3 * s * s * t, c = 3 * s * t * t, d = t * t * t;
+        *x = a * segment.x[0] + b * segment.x[1] + c * segment.x[2] + d * segment.x[3];
+        *y = a * segment.y[0] + b * segment.y[1] + c * segment.y[2] + d * segment.y[3];
+    }
+    else
+    {
+        float a = s * s, b = 2 * s * t, c = t * t;
+        *x = a * segment.x[0] + b * segment.x[1] + c * segment.x[2];
+        *y = a * segment.y[0] + b * segment.y[1] + c * segment.y[2];
+    }
+}
+
+// the part of a cubic between parameters t0 and t1, as a cubic of its own
+MySegment CubicPiece(const MySegment &cubic, float t0, float t1)
+{
+    // end points on the curve, and tangents scaled to the piece's length
+    float h = (t1 - t0) / 3;
+    MySegment piece(3);
+    for (int i = 0; i < 2; ++i)
+    {
+        float t = i ? t1 : t0;
+        float s = 1 - t;
+        float dx = 3 * (s * s * (cubic.x[1] - cubic.x[0]) + 2 * s * t * (cubic.x[2] - cubic.x[1])
+                        + t * t * (cubic.x[3] - cubic.x[2]));
+        float dy = 3 * (s * s * (cubic.y[1] - cubic.y[0]) + 2 * s * t * (cubic.y[2] - cubic.y[1])
+                        + t * t * (cubic.y[3] - cubic.y[2]));
+        float x, y;
+        Evaluate(cubic, t, &x, &y);
+        piece.x[3 * i] = x;
+        piece.y[3 * i] = y;
+        piece.x[i ? 2 : 1] = x + (i ? -h : h) * dx;
+        piece.y[i ? 2 : 1] = y + (i ? -h : h) * dy;
+    }
+    return piece;
+}
+
+int Approximate(const MySegment &cubic, int count, MySegment *quadratics)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        MySegment piece = CubicPiece(cubic, float(i) / count, float(i + 1) / count);
+        MySegment &quadratic = quadratics[i];
+        quadratic.degree = 2;
+        quadratic.x[0] = piece.x[0];
+        quadratic.y[0] = piece.y[0];
+        quadratic.x[1] = (3 * (piece.x[1] + piece.x[2]) - piece.x[0] - piece.x[3]) / 4;
+        quadratic.y[1] = (3 * (piece.y[1] + piece.y[2]) - piece.y[0] - piece.y[3]) / 4;
+        quadratic.x[2] = piece.x[3];
+        quadratic.y[2] = piece.y[3];
+    }
+
+    // the chain must meet the cubic's own end points exactly
+    quadratics[0].x[0] = cubic.x[0];
+    quadratics[0].y[0] = cubic.y[0];
+    quadratics[count - 1].x[2] = cubic.x[3];
+    quadratics[count - 1].y[2] = cubic.y[3];
+    return count;
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+int ApproximateCubic(const MySegment &cubic, float tolerance, MySegment *quadratics)
+{
+    // third difference of the control points, which bounds the error
+    float dx = cubic.x[3] - 3 * cubic.x[2] + 3 * cubic.x[1] - cubic.x[0];
+    float dy = cubic.y[3] - 3 * cubic.y[2] + 3 * cubic.y[1] - cubic.y[0];
+    float bound = sqrt(3.0f) / 36 * sqrt(dx * dx + dy * dy);
+
+    int count = 1;
+    if (tolerance > 0 && bound > tolerance)
+        count = int(ceil(cbrt(bound / tolerance)));
+    count = min(max(count, 1), MAX_QUADRATICS);
+
+    Approximate(cubic, count, quadratics);
+    while (count < MAX_QUADRATICS &&
+           ApproximationError(cubic, quadratics, count, CHECK_SAMPLES) > tolerance)
+        Approximate(cubic, ++count, quadratics);
+    return count;
+}
+
+float ApproximationError(const MySegment &cubic, const MySegment *quadratics,
+                         int count, int samples)
+{
+    float error = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        for (int j = 1; j < samples; ++j)
+        {
+            float u = float(j) / samples;
+            float cx, cy, qx, qy;
+            Evaluate(cubic, (i + u) / count, &cx, &cy);
+            Evaluate(quadratics[i], u, &qx, &qy);
+            error = max(error, sqrt((cx - qx) * (cx - qx) + (cy - qy) * (cy - qy)));
+        }
+    }
+    return error;
+}
@@ -0,0 +1,35 @@
+// ==========================================================================
+// Cubic to Quadratic Approximation
+//  - replaces cubic Bezier segments by chains of quadratic segments
+//
+// A cubic is cut at equal steps of its parameter into n pieces, and each
+// piece is replaced by the quadratic that shares its end points and whose
+// control point is the average of where the piece's two end tangents
+// meet. That quadratic strays from the piece by at most
+// sqrt(3)/36 |p3 - 3p2 + 3p1 - p0|, a difference that shrinks as 1/n^3 as
+// the cubic is cut finer, so the number of pieces needed for a tolerance
+// follows directly. The result is then checked by sampling both curves, and
+// cut finer still should the samples find the bound exceeded.
+// ==========================================================================
+#ifndef CUBICAPPROX_H
+#define CUBICAPPROX_H
+
+#include "GlyphExtractor.h"
+
+// --------------------------------------------------------------------------
+
+// most quadratics a single cubic is replaced by
+const int MAX_QUADRATICS = 16;
+
+// writes quadratic segments that follow the given cubic segment to within
+// tolerance, in the units of its coordinates, to quadratics, which must have
+// room for MAX_QUADRATICS; returns how many were written
+int ApproximateCubic(const MySegment &cubic, float tolerance, MySegment *quadratics);
+
+// greatest distance between a cubic and the quadratics replacing it, found
+// by comparing both at the given number of parameter steps per quadratic
+float ApproximationError(const MySegment &cubic, const MySegment *quadratics,
+                         int count, int samples);
+
+// --------------------------------------------------------------------------
+#endif // CUBICAPPROX_H
@@ -0,0 +1,58 @@
+// ==========================================================================
+// Font Fallback Support
+// ==========================================================================
+
+#include "FontStack.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+MyFontStack::MyFontStack()
+{
+    fill(latin, latin + 256, UNRESOLVED_FACE);
+}
+
+void AddFace(MyFontStack *stack, GlyphExtractor *face)
+{
+    if (stack->faces.size() >= UNRESOLVED_FACE) {
+        cout << "ERROR: font stack is full, face not added" << endl;
+        return;
+    }
+
+    // a new face can only fill characters the others lack, so forget those
+    stack->faces.push_back(face);
+    fill(stack->latin, stack->latin + 256, UNRESOLVED_FACE);
+    stack->resolved.clear();
+}
+
+GlyphExtractor *ResolveFace(MyFontStack *stack, int character)
+{
+    if (stack->faces.empty()) return 0;
+
+    unsigned char *slot;
+    if (character >= 0 && character < 256)
+        slot = &stack->latin[character];
+    else {
+        unordered_map<int, unsigned char>::iterator found = stack->resolved.find(character);
+        if (found != stack->resolved.end())
+            return stack->faces[found->second];
+        slot = &stack->resolved[character];
+        *slot = UNRESOLVED_FACE;
+    }
+
+    if (*slot == UNRESOLVED_FACE)
+    {
+        *slot = 0;
+        for (size_t i = 0; i < stack->faces.size(); ++i)
+            if (stack->faces[i]->GlyphIndex(character) != 0) {
+                *slot = i;
+                break;
+            }
+    }
+
+    return stack->faces[*slot];
+}
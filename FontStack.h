@@ -0,0 +1,45 @@
+// ==========================================================================
+// Font Fallback Support
+//  - picks, for each character, the first face in a stack that can draw it
+//
+// A font stack lists faces in priority order. The first time a code point is
+// asked for, the faces are checked in turn for a glyph; the face chosen is
+// remembered as a one-byte slot in the stack, so mixed-script text only
+// scans the faces once per distinct character. Latin-1 code points keep
+// their slot in a flat array and all others in a hash map. A character that
+// no face covers resolves to the first face, which draws its missing glyph.
+// ==========================================================================
+#ifndef FONTSTACK_H
+#define FONTSTACK_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "GlyphExtractor.h"
+
+// --------------------------------------------------------------------------
+
+struct MyFontStack
+{
+    // faces in priority order; the first is the primary face
+    std::vector<GlyphExtractor *> faces;
+
+    // index into faces of the face resolved for each code point, with
+    // UNRESOLVED_FACE in the Latin-1 table for codes not looked up yet
+    unsigned char latin[256];
+    std::unordered_map<int, unsigned char> resolved;
+
+    MyFontStack();
+};
+
+const unsigned char UNRESOLVED_FACE = 0xFF;
+
+// appends a face to the stack, below those already in it; at most 255 faces
+// fit in a stack
+void AddFace(MyFontStack *stack, GlyphExtractor *face);
+
+// returns the face that draws the given character
+GlyphExtractor *ResolveFace(MyFontStack *stack, int character);
+
+// --------------------------------------------------------------------------
+#endif // FONTSTACK_H
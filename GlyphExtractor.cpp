@@ -17,18 +17,28 @@
 // ==========================================================================
 
 #include "GlyphExtractor.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 // set this true to print information about the font loaded and glyphs extracted
 #define DEBUG_PRINT 0
 
+// set this false to load TrueType and CFF outlines through FreeType as well
+#define NATIVE_TRUETYPE 1
+
+// set this true to check every native outline against FreeType's
+#define VERIFY_NATIVE 0
+
 using namespace std;
 
 // --------------------------------------------------------------------------
 
 GlyphExtractor::GlyphExtractor()
-    : m_face(0)
+    : m_library(0), m_face(0)
 {
+    fill(m_latin, m_latin + 256, 0);
+
     // initialize freetype library
     FT_Error error = FT_Init_FreeType(&m_library);
     if (error) {
@@ -36,10 +46,21 @@ GlyphExtractor::GlyphExtractor()
     }
 }
 
+GlyphExtractor::~GlyphExtractor()
+{
+    CloseTrueTypeFont(&m_native);
+    if (m_face) FT_Done_Face(m_face);
+    if (m_library) FT_Done_FreeType(m_library);
+}
+
 // --------------------------------------------------------------------------
 
-bool GlyphExtractor::LoadFontFile(const string &filename)
+bool GlyphExtractor::LoadFontFile(const string &filename, bool native)
 {
+    if (m_face) {
+        FT_Done_Face(m_face);
+        m_face = 0;
+    }
     FT_Error error = FT_New_Face(m_library, filename.c_str(), 0, &m_face);
 
     if (error == FT_Err_Unknown_File_Format) {
@@ -51,11 +72,145 @@ bool GlyphExtractor::LoadFontFile(const string &filename)
         return false;
     }
 
+    BuildCharMap();
+
+    // fonts that fail to open here stay with FreeType
+    CloseTrueTypeFont(&m_native);
+    if (NATIVE_TRUETYPE && native) OpenTrueTypeFont(&m_native, filename);
+
     if (DEBUG_PRINT) PrintFontInformation();
 
     return true;
 }
 
+int GlyphExtractor::GlyphCount() const
+{
+    return m_face ? m_face->num_glyphs : 0;
+}
+
+int GlyphExtractor::UnitsPerEM() const
+{
+    return m_face ? m_face->units_per_EM : 1;
+}
+
+// --------------------------------------------------------------------------
+
+void GrowBounds(MyBounds &bounds, float x, float y)
+{
+    if (bounds.Empty()) {
+        bounds.xMin = bounds.xMax = x;
+        bounds.yMin = bounds.yMax = y;
+        return;
+    }
+    bounds.xMin = min(bounds.xMin, x);
+    bounds.xMax = max(bounds.xMax, x);
+    bounds.yMin = min(bounds.yMin, y);
+    bounds.yMax = max(bounds.yMax, y);
+}
+
+namespace {
+
+// writes the parameters in (0,1) where the derivative of one coordinate of a
+// curve is zero, returning how many there are
+int Extrema(const float *p, int degree, float *roots)
+{
+    // the derivative is a t^2 + b t + c, up to a constant factor
+    float a = 0, b, c;
+    if (degree == 2) {
+        b = p[0] - 2 * p[1] + p[2];
+        c = p[1] - p[0];
+    }
+    else if (degree == 3) {
+        a = -p[0] + 3 * p[1] - 3 * p[2] + p[3];
+        b = 2 * (p[0] - 2 * p[1] + p[2]);
+        c = p[1] - p[0];
+    }
+    else return 0;
+
+    float found[2];
+    int count = 0;
+    if (a == 0) {
+        if (b != 0) found[count++] = -c / b;
+    }
+    else {
+        float discriminant = b * b - 4 * a * c;
+        if (discriminant >= 0) {
+            float root = sqrt(discriminant);
+            found[count++] = (-b + root) / (2 * a);
+            found[count++] = (-b - root) / (2 * a);
+        }
+    }
+
+    int inside = 0;
+    for (int i = 0; i < count; ++i)
+        if (found[i] > 0 && found[i] < 1) roots[inside++] = found[i];
+    return inside;
+}
+
+// one coordinate of a curve at parameter t
+float Evaluate(const float *p, int degree, float t)
+{
+    float s = 1 - t;
+    if (degree == 2) return s * s * p[0] + 2 * s * t * p[1] + t * t * p[2];
+    return s * s * s * p[0] + 3 * s * s * t * p[1] + 3 * s * t * t * p[2] + t * t * t * p[3];
+}
+
+} // namespace
+
+void GrowBounds(MyBounds &bounds, const MySegment &segment)
+{
+    int degree = min(segment.degree, 3u);
+    GrowBounds(bounds, segment.x[0], segment.y[0]);
+    GrowBounds(bounds, segment.x[degree], segment.y[degree]);
+
+    float roots[2];
+    int count = Extrema(segment.x, degree, roots);
+    for (int i = 0; i < count; ++i)
+        GrowBounds(bounds, Evaluate(segment.x, degree, roots[i]), segment.y[0]);
+    count = Extrema(segment.y, degree, roots);
+    for (int i = 0; i < count; ++i)
+        GrowBounds(bounds, segment.x[0], Evaluate(segment.y, degree, roots[i]));
+}
+
+MyBounds OutlineBounds(const MySegment *segments, int count)
+{
+    MyBounds bounds;
+    for (int i = 0; i < count; ++i)
+        GrowBounds(bounds, segments[i]);
+    return bounds;
+}
+
+// --------------------------------------------------------------------------
+
+void GlyphExtractor::BuildCharMap()
+{
+    fill(m_latin, m_latin + 256, 0);
+    m_cmap.clear();
+
+    // FreeType walks the character map in increasing code order, so the
+    // list comes out sorted
+    FT_UInt index;
+    FT_ULong code = FT_Get_First_Char(m_face, &index);
+    while (index != 0)
+    {
+        if (code < 256) m_latin[code] = index;
+        else m_cmap.push_back(make_pair(code, index));
+        code = FT_Get_Next_Char(m_face, code, &index);
+    }
+}
+
+unsigned int GlyphExtractor::LookupGlyphIndex(int character) const
+{
+    if (character < 0) return 0;
+
+    pair<FT_ULong, FT_UInt> key(character, 0);
+    vector<pair<FT_ULong, FT_UInt> >::const_iterator found =
+        lower_bound(m_cmap.begin(), m_cmap.end(), key);
+    if (found == m_cmap.end() || found->first != FT_ULong(character))
+        return 0;
+    return found->second;
+}
+
 // --------------------------------------------------------------------------
 
 void GlyphExtractor::PrintFontInformation() const
@@ -90,123 +245,226 @@ void GlyphExtractor::PrintGlyphInformation(int character) const
 
 // --------------------------------------------------------------------------
 
-MyGlyph GlyphExtractor::ExtractGlyph(int character) const
+bool GlyphExtractor::LoadOutline(int character, unsigned int index, FT_Outline *outline,
+                                 float *advance) const
 {
     // first check that a font has been loaded
     if (!m_face) {
         cout << "GlyphExtractor ERROR: No font loaded!" << endl;
-        return MyGlyph();
+        return false;
     }
 
-    // look up the glyph index for the given character code
-    int index = FT_Get_Char_Index(m_face, character);
+    // TrueType and CFF outlines are read straight from the mapped font file;
+    // glyphs the native readers refuse are left to FreeType
+    if (m_native.data && LoadTrueTypeGlyph(&m_native, index))
+    {
+        *outline = TrueTypeOutline(&m_native);
+        *advance = m_native.advance / float(m_face->units_per_EM);
+        if (VERIFY_NATIVE) VerifyNativeOutline(character, index);
+        return true;
+    }
 
     // load the glyph for the given character into the face glyph slot,
     // keeping the outline in original font units
     FT_Error error = FT_Load_Glyph(m_face, index, FT_LOAD_NO_SCALE);
     if (error || m_face->glyph->format != FT_GLYPH_FORMAT_OUTLINE)
     {
-        cout << "FreeType ERROR: Could not find glyph outline for character "
-             << character << " (" << char(character) << ")" <<  endl;
-        return MyGlyph();
+        cout << "FreeType ERROR: Could not find outline of glyph " << index;
+        if (character >= 0)
+            cout << " for character " << character << " (" << char(character) << ")";
+        cout << endl;
+        return false;
     }
 
-    if (DEBUG_PRINT) PrintGlyphInformation(character);
+    if (DEBUG_PRINT && character >= 0) PrintGlyphInformation(character);
 
-    // create a new glyph structure to populate with this character outline
-    FT_Outline &outline = m_face->glyph->outline;
-    float em = m_face->units_per_EM;
-    MyGlyph glyph(m_face->glyph->advance.x / em);
+    *outline = m_face->glyph->outline;
+    *advance = m_face->glyph->advance.x / float(m_face->units_per_EM);
+    return true;
+}
 
-    // current point index
-    int begin = 0;
+void GlyphExtractor::VerifyNativeOutline(int character, int index) const
+{
+    FT_Error error = FT_Load_Glyph(m_face, index, FT_LOAD_NO_SCALE);
+    if (error) return;
+
+    FT_Outline &expected = m_face->glyph->outline;
+    bool same = expected.n_points == int(m_native.points.size()) &&
+                expected.n_contours == int(m_native.contours.size()) &&
+                m_face->glyph->advance.x == m_native.advance;
+    for (int i = 0; same && i < expected.n_points; ++i)
+        same = expected.points[i].x == m_native.points[i].x &&
+               expected.points[i].y == m_native.points[i].y &&
+               (expected.tags[i] & 3) == (m_native.tags[i] & 3);
+    for (int c = 0; same && c < expected.n_contours; ++c)
+        same = expected.contours[c] == m_native.contours[c];
+
+    if (!same)
+        cout << "GlyphExtractor ERROR: native outline of character " << character
+             << " differs from FreeType's" << endl;
+}
 
-    // iterate through the outline's contours
-    for (int c = 0; c < outline.n_contours; ++c)
+int GlyphExtractor::ConvertContour(const FT_Outline &outline, int begin, int end,
+                                   MySegment *segments) const
+{
+    float em = m_face->units_per_EM;
+    int count = 0;
+
+    // iterate through current contour's points
+    for (int p = begin; p <= end; ++p)
     {
-        MyContour contour;
+        // index for next point, q
+        int q = p+1;
+        if (q > end) q = begin;
 
-        // iterate through current contour's points
-        int end = outline.contours[c];
-        for (int p = begin; p <= end; ++p)
-        {
-            // index for next point, q
-            int q = p+1;
-            if (q > end) q = begin;
+        // retrieve position vectors
+        FT_Vector r_p = outline.points[p];
+        FT_Vector r_q = outline.points[q];
 
-            // retrieve position vectors
-            FT_Vector r_p = outline.points[p];
-            FT_Vector r_q = outline.points[q];
+        // create a segment to store control points
+        MySegment segment;
 
-            // create a segment to store control points
-            MySegment segment;
+        if (outline.tags[p] & 1) {
+            segment.x[0] = r_p.x / em;
+            segment.y[0] = r_p.y / em;
+        }
+        else {
+            segment.x[0] = 0.5f * (r_p.x + r_q.x) / em;
+            segment.y[0] = 0.5f * (r_p.y + r_q.y) / em;
+        }
 
-            if (outline.tags[p] & 1) {
-                segment.x[0] = r_p.x / em;
-                segment.y[0] = r_p.y / em;
+        // set degree of segment based on what the next point is
+        if (outline.tags[q] & 1)
+        {
+            // next point is on curve, so this is a line segment
+            segment.degree = 1;
+            segment.x[1] = r_q.x / em;
+            segment.y[1] = r_q.y / em;
+        }
+        else if (outline.tags[q] & 2)
+        {
+            // next point is third degree, so this is a cubic segment
+            segment.degree = 3;
+            for (int i = 0; i < 3; ++i)
+            {
+                segment.x[1+i] = r_q.x / em;
+                segment.y[1+i] = r_q.y / em;
+                if (++q > end) q = begin;
+                r_q = outline.points[q];
+            }
+            p += 2;
+        }
+        else
+        {
+            // next point is second degree, so this is a quadratic segment
+            segment.degree = 2;
+            segment.x[1] = r_q.x / em;
+            segment.y[1] = r_q.y / em;
+
+            // advance q
+            if (++q > end) q = begin;
+            r_q = outline.points[q];
+
+            // if the next point is on curve, store and advance p
+            if (outline.tags[q] & 1) {
+                segment.x[2] = r_q.x / em;
+                segment.y[2] = r_q.y / em;
+                ++p;
             }
+            // otherwise store the midpoint
             else {
-                segment.x[0] = 0.5f * (r_p.x + r_q.x) / em;
-                segment.y[0] = 0.5f * (r_p.y + r_q.y) / em;
+                segment.x[2] = 0.5f * (segment.x[1] + r_q.x / em);
+                segment.y[2] = 0.5f * (segment.y[1] + r_q.y / em);
             }
+        }
 
-            // set degree of segment based on what the next point is
-            if (outline.tags[q] & 1)
-            {
-                // next point is on curve, so this is a line segment
-                segment.degree = 1;
-                segment.x[1] = r_q.x / em;
-                segment.y[1] = r_q.y / em;
-            }
-            else if (outline.tags[q] & 2)
-            {
-                // next point is third degree, so this is a cubic segment
-                segment.degree = 3;
-                for (int i = 0; i < 3; ++i)
-                {
-                    segment.x[1+i] = r_q.x / em;
-                    segment.y[1+i] = r_q.y / em;
-                    if (++q > end) q = begin;
-                    r_q = outline.points[q];
-                }
-                p += 2;
-            }
-            else
-            {
-                // next point is second degree, so this is a quadratic segment
-                segment.degree = 2;
-                segment.x[1] = r_q.x / em;
-                segment.y[1] = r_q.y / em;
+        // add segment to contour
+        if (segments) segments[count] = segment;
+        ++count;
+    }
 
-                // advance q
-                if (++q > end) q = begin;
-                r_q = outline.points[q];
+    return count;
+}
 
-                // if the next point is on curve, store and advance p
-                if (outline.tags[q] & 1) {
-                    segment.x[2] = r_q.x / em;
-                    segment.y[2] = r_q.y / em;
-                    ++p;
-                }
-                // otherwise store the midpoint
-                else {
-                    segment.x[2] = 0.5f * (segment.x[1] + r_q.x / em);
-                    segment.y[2] = 0.5f * (segment.y[1] + r_q.y / em);
-                }
-            }
+MyGlyph GlyphExtractor::ExtractGlyph(int character) const
+{
+    FT_Outline outline;
+    float advance;
+    if (!LoadOutline(character, GlyphIndex(character), &outline, &advance))
+        return MyGlyph();
 
-            // add segment to contour
-            contour.push_back(segment);
-        }
+    // create a new glyph structure to populate with this character outline
+    MyGlyph glyph(advance);
+    glyph.contours.reserve(outline.n_contours);
+
+    // current point index
+    int begin = 0;
+
+    // iterate through the outline's contours, each of which has at most as
+    // many segments as it has points
+    for (int c = 0; c < outline.n_contours; ++c)
+    {
+        int end = outline.contours[c];
+        MyContour contour(end - begin + 1);
+        contour.resize(ConvertContour(outline, begin, end, &contour[0]));
 
         // set beginning of next contour
         begin = end + 1;
 
         // add contour to glyph
-        glyph.contours.push_back(contour);
+        for (size_t s = 0; s < contour.size(); ++s)
+            GrowBounds(glyph.bounds, contour[s]);
+        glyph.contours.push_back(std::move(contour));
     }
 
     return glyph;
 }
 
+int GlyphExtractor::ExtractSegments(int character, MySegment *segments, int maxSegments,
+                                    int *contourEnds, int maxContours, int *contourCount,
+                                    float *advance) const
+{
+    return WriteSegments(character, GlyphIndex(character), segments, maxSegments,
+                         contourEnds, maxContours, contourCount, advance);
+}
+
+int GlyphExtractor::ExtractGlyphSegments(unsigned int index, MySegment *segments, int maxSegments,
+                                         int *contourEnds, int maxContours, int *contourCount,
+                                         float *advance) const
+{
+    return WriteSegments(-1, index, segments, maxSegments,
+                         contourEnds, maxContours, contourCount, advance);
+}
+
+int GlyphExtractor::WriteSegments(int character, unsigned int index, MySegment *segments,
+                                  int maxSegments, int *contourEnds, int maxContours,
+                                  int *contourCount, float *advance) const
+{
+    *contourCount = 0;
+    *advance = 0;
+    FT_Outline outline;
+    if (!LoadOutline(character, index, &outline, advance))
+        return 0;
+
+    *contourCount = outline.n_contours;
+
+    int count = 0;
+    int begin = 0;
+    for (int c = 0; c < outline.n_contours; ++c)
+    {
+        int end = outline.contours[c];
+
+        // write the contour only where it is sure to fit, otherwise just
+        // count it so the caller learns how much space to provide
+        int fits = (count + end - begin + 1 <= maxSegments);
+        if (!fits) fits = (count + ConvertContour(outline, begin, end, 0) <= maxSegments);
+        count += ConvertContour(outline, begin, end, fits ? segments + count : 0);
+
+        if (c < maxContours) contourEnds[c] = count;
+        begin = end + 1;
+    }
+
+    return count;
+}
+
 // --------------------------------------------------------------------------
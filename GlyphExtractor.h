@@ -19,11 +19,14 @@
 #define GLYPHEXTRACTOR_H
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
+#include "TrueType.h"
+
 // --------------------------------------------------------------------------
 // DATA STRUCTURES: Segment, Contour, and Glyph
 
@@ -44,6 +47,27 @@ struct MySegment
 // An contour is a Bezier spline: a sequence of curve segments that share endpoints.
 typedef std::vector<MySegment> MyContour;
 
+// An axis-aligned box, which is empty while its minimum exceeds its maximum.
+struct MyBounds
+{
+    float xMin, yMin, xMax, yMax;
+
+    MyBounds() : xMin(1), yMin(1), xMax(-1), yMax(-1)
+    {}
+
+    bool Empty() const { return xMin > xMax; }
+};
+
+// grows a box to take in a point
+void GrowBounds(MyBounds &bounds, float x, float y);
+
+// grows a box to take in a segment: its end points and the extrema of the
+// curve between them, found where the derivative of each coordinate is zero
+void GrowBounds(MyBounds &bounds, const MySegment &segment);
+
+// the exact bounding box of a list of segments
+MyBounds OutlineBounds(const MySegment *segments, int count);
+
 // A glyph consists of a set of contours and an advance width to the next glyph.
 struct MyGlyph
 {
@@ -53,6 +77,9 @@ struct MyGlyph
     // contours that form this glyph, in EM-box coordinates
     std::vector<MyContour> contours;
 
+    // tight bounding box of the contours, in EM-box coordinates
+    MyBounds bounds;
+
     MyGlyph(float adv = 0) : advance(adv)
     {}
 };
@@ -66,18 +93,91 @@ class GlyphExtractor
     FT_Library  m_library;
     FT_Face     m_face;
 
+    // the font file read directly when it has TrueType or CFF outlines; the
+    // glyph it last loaded is kept in it, so it changes on const extraction
+    mutable MyTrueTypeFont m_native;
+
+    // glyph indices of the font's character map, read once at load time:
+    // Latin-1 codes index a flat array directly, and every other code is
+    // found by binary search in a list of (code, index) pairs sorted by code
+    FT_UInt     m_latin[256];
+    std::vector<std::pair<FT_ULong, FT_UInt> > m_cmap;
+
+    // fills the lookup tables above from the loaded face's character map
+    void BuildCharMap();
+
+    // finds characters outside Latin-1 in the sorted character map
+    unsigned int LookupGlyphIndex(int character) const;
+
+    // loads the outline of a glyph, natively or into the face's glyph slot,
+    // and gives a view of it in font units along with the advance; character
+    // is the code the glyph was asked for, or -1, and only used in messages
+    bool LoadOutline(int character, unsigned int index, FT_Outline *outline, float *advance) const;
+
+    // writes the segments of a glyph as ExtractSegments describes
+    int WriteSegments(int character, unsigned int index, MySegment *segments, int maxSegments,
+                      int *contourEnds, int maxContours, int *contourCount,
+                      float *advance) const;
+
+    // reports a native outline that differs from FreeType's, for debugging
+    void VerifyNativeOutline(int character, int index) const;
+
+    // converts the points of one contour of an outline into segments,
+    // writing them to segments unless it is null; returns the segment count,
+    // which is never more than the number of points in the contour
+    int ConvertContour(const FT_Outline &outline, int begin, int end,
+                       MySegment *segments) const;
+
     // private methods to print font/glyph info, for debugging
     void PrintFontInformation() const;
     void PrintGlyphInformation(int character) const;
 
+    // the class owns its FreeType face and mapped font file, so it is not copied
+    GlyphExtractor(const GlyphExtractor &) = delete;
+    GlyphExtractor &operator=(const GlyphExtractor &) = delete;
+
 public:
     GlyphExtractor();
+    ~GlyphExtractor();
 
-    // call this method first to load a font file
-    bool LoadFontFile(const std::string &filename);
+    // call this method first to load a font file; with native false, every
+    // outline is loaded through FreeType even if the font could be read natively
+    bool LoadFontFile(const std::string &filename, bool native = true);
 
     // this method retrieves a (possibly composite) glyph for the given character
     MyGlyph ExtractGlyph(int character) const;
+
+    // this method writes the glyph for the given character into arrays the
+    // caller provides, without allocating: the segments of all contours back
+    // to back, and for each contour the index one past its last segment. It
+    // returns the number of segments in the glyph and sets the number of
+    // contours and the advance; if either count is more than the space
+    // given, the arrays are incomplete and the call should be repeated with
+    // arrays of at least the counts returned
+    int ExtractSegments(int character, MySegment *segments, int maxSegments,
+                        int *contourEnds, int maxContours, int *contourCount,
+                        float *advance) const;
+
+    // the same as ExtractSegments for the glyph with the given index, which
+    // also reaches glyphs that no character maps to
+    int ExtractGlyphSegments(unsigned int index, MySegment *segments, int maxSegments,
+                             int *contourEnds, int maxContours, int *contourCount,
+                             float *advance) const;
+
+    // number of glyphs in the loaded font
+    int GlyphCount() const;
+
+    // number of font units per EM of the loaded font
+    int UnitsPerEM() const;
+
+    // index of the glyph for the given character in the loaded font, or 0
+    // if the font has no glyph for it
+    unsigned int GlyphIndex(int character) const
+    {
+        if (character >= 0 && character < 256)
+            return m_latin[character];
+        return LookupGlyphIndex(character);
+    }
 };
 
 // --------------------------------------------------------------------------
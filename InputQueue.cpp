@@ -0,0 +1,53 @@
+// ==========================================================================
+// Input Event Queue
+// ==========================================================================
+
+#include "InputQueue.h"
+
+// --------------------------------------------------------------------------
+
+bool PushInput(MyInputQueue *queue, const MyInputEvent &event)
+{
+    unsigned int tail = queue->tail.load(std::memory_order_relaxed);
+    unsigned int head = queue->head.load(std::memory_order_acquire);
+    if (tail - head == INPUT_QUEUE_SIZE)
+        return false;
+
+    queue->events[tail % INPUT_QUEUE_SIZE] = event;
+
+    // the store of tail and the load of sleeping are sequentially consistent,
+    // as are the consumer's store of sleeping and load of tail, so either the
+    // consumer sees this event or this sees the consumer going to sleep
+    queue->tail.store(tail + 1, std::memory_order_seq_cst);
+    if (!queue->sleeping.load(std::memory_order_seq_cst))
+        return true;
+
+    // taking the mutex orders this wake after a consumer that has just seen
+    // the queue empty has gone to sleep, so the wake cannot be lost
+    {
+        std::lock_guard<std::mutex> lock(queue->sleepMutex);
+    }
+    queue->wake.notify_one();
+    return true;
+}
+
+bool PopInput(MyInputQueue *queue, MyInputEvent *event)
+{
+    unsigned int head = queue->head.load(std::memory_order_relaxed);
+    unsigned int tail = queue->tail.load(std::memory_order_acquire);
+    if (head == tail)
+        return false;
+
+    *event = queue->events[head % INPUT_QUEUE_SIZE];
+    queue->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+void WaitForInput(MyInputQueue *queue)
+{
+    std::unique_lock<std::mutex> lock(queue->sleepMutex);
+    queue->sleeping.store(true, std::memory_order_seq_cst);
+    while (queue->head.load(std::memory_order_relaxed) == queue->tail.load(std::memory_order_seq_cst))
+        queue->wake.wait(lock);
+    queue->sleeping.store(false, std::memory_order_relaxed);
+}
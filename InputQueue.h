@@ -0,0 +1,75 @@
+// ==========================================================================
+// Input Event Queue
+//  - hands window input from the GLFW event thread to the render thread
+//
+// The queue is a fixed ring with a single producer (the thread running the
+// GLFW callbacks) and a single consumer (the render thread). Pushing and
+// popping never take a lock: each side owns one index and publishes it with
+// release/acquire ordering. The mutex and condition variable are only used
+// to put an idle render thread to sleep until the next event arrives, and
+// the producer touches them only when the consumer has said it is asleep.
+// ==========================================================================
+#ifndef INPUTQUEUE_H
+#define INPUTQUEUE_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// --------------------------------------------------------------------------
+// An input event as reported to a GLFW callback
+
+enum MyInputType { INPUT_KEY, INPUT_MOUSE, INPUT_RESIZE, INPUT_REFRESH, INPUT_CLOSE };
+
+struct MyInputEvent
+{
+    MyInputType type;
+
+    // the key or mouse button, and whether it was pressed or released
+    int key;
+    int action;
+
+    // glfwGetTime() when the callback received the event
+    double time;
+
+    // for mouse events, the cursor position in view coordinates, which span
+    // -1 to 1 from the bottom left of the window to the top right
+    float x, y;
+
+    // for resize events, the new size of the framebuffer in pixels
+    int width, height;
+};
+
+// number of slots in the ring, a power of two
+const unsigned int INPUT_QUEUE_SIZE = 256;
+
+struct MyInputQueue
+{
+    MyInputEvent events[INPUT_QUEUE_SIZE];
+
+    // next slot to read, written only by the consumer, and next slot to
+    // write, written only by the producer; both count up and wrap freely
+    std::atomic<unsigned int> head;
+    std::atomic<unsigned int> tail;
+
+    // lets the consumer sleep while the queue is empty; the producer only
+    // takes the mutex to wake it while sleeping is set
+    std::atomic<bool>       sleeping;
+    std::mutex              sleepMutex;
+    std::condition_variable wake;
+
+    MyInputQueue() : head(0), tail(0), sleeping(false)
+    {}
+};
+
+// adds an event and wakes the consumer, returning false if the queue is full
+bool PushInput(MyInputQueue *queue, const MyInputEvent &event);
+
+// removes the oldest event, returning false if there is none
+bool PopInput(MyInputQueue *queue, MyInputEvent *event);
+
+// blocks the consumer until at least one event is waiting
+void WaitForInput(MyInputQueue *queue);
+
+// --------------------------------------------------------------------------
+#endif // INPUTQUEUE_H
@@ -0,0 +1,193 @@
+// ==========================================================================
+// Work-Stealing Job System
+// ==========================================================================
+
+#include "JobSystem.h"
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+namespace
+{
+    struct MyJob
+    {
+        function<void()> work;
+        MyJobGroup      *group;
+    };
+
+    // the deque of one thread; its owner works at the back, thieves at the front
+    struct MyJobDeque
+    {
+        mutex        lock;
+        deque<MyJob> jobs;
+    };
+
+    // deque 0 is shared by threads outside the pool, the rest belong to workers
+    vector<MyJobDeque *> deques(1, new MyJobDeque);
+    vector<thread>       workers;
+
+    // jobs sitting in any deque, and whether the workers should exit
+    atomic<int>  queued(0);
+    atomic<bool> stopping(false);
+
+    // lets idle workers sleep until a job is spawned
+    mutex              sleepMutex;
+    condition_variable wake;
+
+    // index of the calling thread's deque
+    thread_local int dequeIndex = 0;
+
+    bool PopJob(int index, MyJob *job)
+    {
+        MyJobDeque *own = deques[index];
+        lock_guard<mutex> guard(own->lock);
+        if (own->jobs.empty())
+            return false;
+        *job = own->jobs.back();
+        own->jobs.pop_back();
+        return true;
+    }
+
+    bool StealJob(int index, MyJob *job)
+    {
+        int count = deques.size();
+        for (int i = 1; i < count; i++)
+        {
+            MyJobDeque *victim = deques[(index + i) % count];
+            lock_guard<mutex> guard(victim->lock);
+            if (victim->jobs.empty())
+                continue;
+            *job = victim->jobs.front();
+            victim->jobs.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    // runs one job from the thread's own deque or stolen from another,
+    // returning false if there was none to run
+    bool RunJob(int index)
+    {
+        MyJob job;
+        if (!PopJob(index, &job) && !StealJob(index, &job))
+            return false;
+
+        queued.fetch_sub(1);
+        job.work();
+        job.group->pending.fetch_sub(1, memory_order_release);
+        return true;
+    }
+
+    void WorkerLoop(int index)
+    {
+        dequeIndex = index;
+        while (true)
+        {
+            if (RunJob(index))
+                continue;
+
+            unique_lock<mutex> lock(sleepMutex);
+            while (!stopping && queued.load() == 0)
+                wake.wait(lock);
+            if (stopping && queued.load() == 0)
+                return;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+
+void InitializeJobs(int workerCount)
+{
+    if (workerCount < 0)
+        workerCount = max(1u, thread::hardware_concurrency()) - 1;
+
+    stopping = false;
+    for (int i = 0; i < workerCount; i++)
+        deques.push_back(new MyJobDeque);
+    for (int i = 0; i < workerCount; i++)
+        workers.push_back(thread(WorkerLoop, i + 1));
+}
+
+void DestroyJobs()
+{
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+    workers.clear();
+
+    for (size_t i = 1; i < deques.size(); i++)
+        delete deques[i];
+    deques.resize(1);
+}
+
+void SpawnJob(MyJobGroup *group, const function<void()> &work)
+{
+    MyJob job = { work, group };
+    group->pending.fetch_add(1);
+
+    MyJobDeque *own = deques[dequeIndex];
+    {
+        lock_guard<mutex> guard(own->lock);
+        own->jobs.push_back(job);
+    }
+    queued.fetch_add(1);
+
+    // taking the mutex orders this wake after a worker that has just seen
+    // nothing queued has gone to sleep, so the wake cannot be lost
+    {
+        lock_guard<mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+void WaitForJobs(MyJobGroup *group)
+{
+    while (group->pending.load(memory_order_acquire) > 0)
+    {
+        if (!RunJob(dequeIndex))
+            this_thread::yield();
+    }
+}
+
+// --------------------------------------------------------------------------
+
+namespace
+{
+    // splits off the upper half of the range as a job until what is left
+    // fits in one grain, then runs that; thieves take the larger halves
+    void SplitRange(MyJobGroup *group, int begin, int end, int grain,
+                    const function<void(int, int)> *body)
+    {
+        while (end - begin > grain)
+        {
+            int middle = begin + (end - begin) / 2;
+            int last = end;
+            SpawnJob(group, [=]() { SplitRange(group, middle, last, grain, body); });
+            end = middle;
+        }
+        (*body)(begin, end);
+    }
+}
+
+void ParallelFor(int begin, int end, int grain, const function<void(int, int)> &body)
+{
+    if (begin >= end)
+        return;
+
+    MyJobGroup group;
+    SplitRange(&group, begin, end, max(1, grain), &body);
+    WaitForJobs(&group);
+}
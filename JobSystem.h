@@ -0,0 +1,48 @@
+// ==========================================================================
+// Work-Stealing Job System
+//  - one pool of worker threads shared by every CPU-side preprocessing step
+//
+// Each thread has its own deque of jobs. A thread pushes and pops jobs at
+// the back of its own deque, so recently split work stays on the core that
+// split it, and when it runs dry it steals the oldest (and so largest) job
+// from the front of another thread's deque. Threads that are not workers,
+// such as the render thread, share one extra deque and help run jobs while
+// they wait for the work they spawned.
+// ==========================================================================
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <functional>
+
+// --------------------------------------------------------------------------
+// A set of jobs that can be waited on together
+
+struct MyJobGroup
+{
+    // jobs spawned into the group that have not finished yet
+    std::atomic<int> pending;
+
+    MyJobGroup() : pending(0)
+    {}
+};
+
+// starts the worker threads, by default one for each core beyond the one
+// the calling thread runs on
+void InitializeJobs(int workerCount = -1);
+
+// finishes any queued jobs and stops the worker threads
+void DestroyJobs();
+
+// queues a job on the calling thread's deque
+void SpawnJob(MyJobGroup *group, const std::function<void()> &work);
+
+// runs queued or stolen jobs until every job in the group has finished
+void WaitForJobs(MyJobGroup *group);
+
+// calls body(first, last) on disjoint subranges, of at most grain items,
+// that together cover [begin, end), returning when all have finished
+void ParallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body);
+
+// --------------------------------------------------------------------------
+#endif // JOBSYSTEM_H
@@ -0,0 +1,377 @@
+// ==========================================================================
+// Resolution-Independent Curve Fill Support
+//  - after Loop & Blinn, "Resolution Independent Curve Rendering using
+//    Programmable Graphics Hardware" (SIGGRAPH 2005)
+//
+// This module turns glyph outlines into triangles for a stencil-then-cover
+// fill. See LoopBlinn.h for an overview.
+// ==========================================================================
+
+#include "LoopBlinn.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// tolerance for classifying a cubic, relative to its normalized size
+const double CLASSIFY_EPSILON = 1e-7;
+
+// how many times a cubic piece may be halved to make its hull convex
+const int MAX_SPLIT_DEPTH = 4;
+
+// --------------------------------------------------------------------------
+// A control point together with its curve coordinates. The coordinates are
+// affine functions of position, so subdividing them alongside the control
+// points leaves them valid for every piece of the curve.
+
+struct CurvePoint
+{
+    double x, y;
+    double k, l, m;
+};
+
+CurvePoint Lerp(const CurvePoint &a, const CurvePoint &b, double t)
+{
+    CurvePoint r;
+    r.x = a.x + (b.x - a.x) * t;
+    r.y = a.y + (b.y - a.y) * t;
+    r.k = a.k + (b.k - a.k) * t;
+    r.l = a.l + (b.l - a.l) * t;
+    r.m = a.m + (b.m - a.m) * t;
+    return r;
+}
+
+// splits a cubic at parameter t into left and right halves (de Casteljau)
+void Subdivide(const CurvePoint p[4], double t, CurvePoint left[4], CurvePoint right[4])
+{
+    CurvePoint p01 = Lerp(p[0], p[1], t);
+    CurvePoint p12 = Lerp(p[1], p[2], t);
+    CurvePoint p23 = Lerp(p[2], p[3], t);
+    CurvePoint p012 = Lerp(p01, p12, t);
+    CurvePoint p123 = Lerp(p12, p23, t);
+    CurvePoint mid = Lerp(p012, p123, t);
+
+    left[0] = p[0];  left[1] = p01;   left[2] = p012;  left[3] = mid;
+    right[0] = mid;  right[1] = p123; right[2] = p23;  right[3] = p[3];
+}
+
+// twice the signed area of triangle abc
+double Orient(const CurvePoint &a, const CurvePoint &b, const CurvePoint &c)
+{
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+// --------------------------------------------------------------------------
+// Curve coordinates along the curve are products of three linear factors in
+// the curve parameter t; their Bernstein coefficients are the coordinates to
+// assign to the control points.
+
+// a linear factor a + b*t
+struct Factor
+{
+    double a, b;
+};
+
+const Factor ONE = { 1, 0 };
+
+// factor vanishing at the homogeneous root s/t, normalized so that roots near
+// infinity do not blow up the coordinate values
+Factor RootFactor(double s, double t)
+{
+    double n = sqrt(s*s + t*t);
+    Factor f = { -s / n, t / n };
+    return f;
+}
+
+// Bernstein coefficients of f[0](t) f[1](t) f[2](t), from its symmetric
+// blossom evaluated at (0,0,0), (0,0,1), (0,1,1) and (1,1,1)
+void BernsteinCoefficients(const Factor f[3], double coeff[4])
+{
+    static const int perms[6][3] = {
+        {0,1,2}, {0,2,1}, {1,0,2}, {1,2,0}, {2,0,1}, {2,1,0}
+    };
+
+    for (int i = 0; i < 4; ++i)
+    {
+        double sum = 0;
+        for (int p = 0; p < 6; ++p)
+        {
+            double product = 1;
+            for (int j = 0; j < 3; ++j)
+            {
+                const Factor &factor = f[perms[p][j]];
+                product *= (j >= 3 - i) ? factor.a + factor.b : factor.a;
+            }
+            sum += product;
+        }
+        coeff[i] = sum / 6;
+    }
+}
+
+void AssignCoordinates(CurvePoint p[4], const Factor k[3], const Factor l[3], const Factor m[3])
+{
+    double kc[4], lc[4], mc[4];
+    BernsteinCoefficients(k, kc);
+    BernsteinCoefficients(l, lc);
+    BernsteinCoefficients(m, mc);
+
+    for (int i = 0; i < 4; ++i) {
+        p[i].k = kc[i];
+        p[i].l = lc[i];
+        p[i].m = mc[i];
+    }
+}
+
+// records a split parameter if it falls strictly inside the curve
+void AddSplit(double s, double t, ArenaVector<double> &splits)
+{
+    if (fabs(t) < CLASSIFY_EPSILON) return;
+    double u = s / t;
+    if (u > CLASSIFY_EPSILON && u < 1 - CLASSIFY_EPSILON)
+        splits.push_back(u);
+}
+
+// classifies a cubic, assigns its (k,l,m) coordinates, and collects the
+// parameters at which it must be split; returns false if the cubic is a line
+bool ClassifyCubic(CurvePoint p[4], ArenaVector<double> &splits)
+{
+    // normalize the control points so the tolerances are scale-independent
+    double size = 0;
+    for (int i = 1; i < 4; ++i)
+        size = max(size, max(fabs(p[i].x - p[0].x), fabs(p[i].y - p[0].y)));
+    if (size == 0) return false;
+
+    double x[4], y[4];
+    for (int i = 0; i < 4; ++i) {
+        x[i] = (p[i].x - p[0].x) / size;
+        y[i] = (p[i].y - p[0].y) / size;
+    }
+
+    // power basis coefficients: B(t) = a t^3 + b t^2 + c t + d
+    double ax = -x[0] + 3*x[1] - 3*x[2] + x[3], ay = -y[0] + 3*y[1] - 3*y[2] + y[3];
+    double bx = 3*x[0] - 6*x[1] + 3*x[2],       by = 3*y[0] - 6*y[1] + 3*y[2];
+    double cx = -3*x[0] + 3*x[1],               cy = -3*y[0] + 3*y[1];
+
+    // inflections are the roots of A t^2 + B t + C, from B' x B''
+    double A = ax*by - ay*bx;
+    double B = ax*cy - ay*cx;
+    double C = (bx*cy - by*cx) / 3;
+
+    Factor k[3], l[3], m[3];
+
+    if (fabs(A) < CLASSIFY_EPSILON && fabs(B) < CLASSIFY_EPSILON)
+    {
+        // no inflections: a line, or a quadratic written as a cubic
+        if (fabs(C) < CLASSIFY_EPSILON) return false;
+
+        Factor t = { 0, 1 };
+        k[0] = t;  k[1] = ONE; k[2] = ONE;
+        l[0] = t;  l[1] = t;   l[2] = ONE;
+        m[0] = t;  m[1] = ONE; m[2] = ONE;
+    }
+    else
+    {
+        double D = B*B - 4*A*C;
+
+        if (D >= 0)
+        {
+            // serpentine (or cusp when D = 0), with k through the inflections
+            // and l, m tangent at them; a zero A puts one inflection at infinity
+            double q = sqrt(D);
+            Factor fl = (fabs(A) < CLASSIFY_EPSILON) ? RootFactor(-C, B) : RootFactor(-B - q, 2*A);
+            Factor fm = (fabs(A) < CLASSIFY_EPSILON) ? RootFactor(1, 0)  : RootFactor(-B + q, 2*A);
+
+            k[0] = fl; k[1] = fm; k[2] = ONE;
+            l[0] = fl; l[1] = fl; l[2] = fl;
+            m[0] = fm; m[1] = fm; m[2] = fm;
+
+            if (fabs(A) < CLASSIFY_EPSILON)
+                AddSplit(-C, B, splits);
+            else {
+                AddSplit(-B - q, 2*A, splits);
+                AddSplit(-B + q, 2*A, splits);
+            }
+        }
+        else
+        {
+            // loop, with parameters td and te meeting at the double point
+            double q = sqrt(-3*D);
+            Factor fd = RootFactor(-B - q, 2*A);
+            Factor fe = RootFactor(-B + q, 2*A);
+
+            k[0] = fd; k[1] = fe; k[2] = ONE;
+            l[0] = fd; l[1] = fd; l[2] = fe;
+            m[0] = fd; m[1] = fe; m[2] = fe;
+
+            AddSplit(-B - q, 2*A, splits);
+            AddSplit(-B + q, 2*A, splits);
+        }
+    }
+
+    AssignCoordinates(p, k, l, m);
+    sort(splits.begin(), splits.end());
+    return true;
+}
+
+// --------------------------------------------------------------------------
+// Triangle output
+
+void AddVertex(ArenaVector<MyFillVertex> &triangles, double x, double y,
+               double k, double l, double m, int degree, float penX)
+{
+    MyFillVertex v;
+    v.x = float(x) + penX;
+    v.y = float(y);
+    v.k = float(k);
+    v.l = float(l);
+    v.m = float(m);
+    v.degree = float(degree);
+    triangles.push_back(v);
+}
+
+// solid triangle from the contour anchor over one chord of the outline
+void AddFan(ArenaVector<MyFillVertex> &triangles, float ax, float ay,
+            float x0, float y0, float x1, float y1, float penX)
+{
+    AddVertex(triangles, ax, ay, 0, 0, 0, 0, penX);
+    AddVertex(triangles, x0, y0, 0, 0, 0, 0, penX);
+    AddVertex(triangles, x1, y1, 0, 0, 0, 0, penX);
+}
+
+void AddCurvePoint(ArenaVector<MyFillVertex> &triangles, const CurvePoint &p, float penX)
+{
+    AddVertex(triangles, p.x, p.y, p.k, p.l, p.m, 3, penX);
+}
+
+// emits the chord and hull triangles for one piece of a classified cubic
+void AddCubicPiece(ArenaVector<MyFillVertex> &triangles, const CurvePoint p[4],
+                   float ax, float ay, float penX, int depth)
+{
+    // the hull triangles only cover the curve once if the control polygon is
+    // convex, so halve the piece until it is
+    double o[4] = {
+        Orient(p[0], p[1], p[2]), Orient(p[1], p[2], p[3]),
+        Orient(p[2], p[3], p[0]), Orient(p[3], p[0], p[1])
+    };
+    bool convex = (o[0] >= 0 && o[1] >= 0 && o[2] >= 0 && o[3] >= 0)
+               || (o[0] <= 0 && o[1] <= 0 && o[2] <= 0 && o[3] <= 0);
+
+    // orient the coordinates so the area between chord and curve is negative,
+    // testing at the chord midpoint; this vanishes for the closed piece of a
+    // loop, whose chord has collapsed onto the double point, so halve that too
+    double k = 0.5 * (p[0].k + p[3].k);
+    double l = 0.5 * (p[0].l + p[3].l);
+    double m = 0.5 * (p[0].m + p[3].m);
+    double f = k*k*k - l*m;
+    bool flat = fabs(f) < 1e-12;
+
+    if ((!convex || flat) && depth < MAX_SPLIT_DEPTH)
+    {
+        CurvePoint left[4], right[4];
+        Subdivide(p, 0.5, left, right);
+        AddCubicPiece(triangles, left, ax, ay, penX, depth + 1);
+        AddCubicPiece(triangles, right, ax, ay, penX, depth + 1);
+        return;
+    }
+
+    AddFan(triangles, ax, ay, p[0].x, p[0].y, p[3].x, p[3].y, penX);
+    if (!convex || flat) return;
+
+    CurvePoint q[4];
+    for (int i = 0; i < 4; ++i) {
+        q[i] = p[i];
+        if (f > 0) {
+            q[i].k = -q[i].k;
+            q[i].l = -q[i].l;
+        }
+    }
+
+    AddCurvePoint(triangles, q[0], penX);
+    AddCurvePoint(triangles, q[1], penX);
+    AddCurvePoint(triangles, q[2], penX);
+    AddCurvePoint(triangles, q[0], penX);
+    AddCurvePoint(triangles, q[2], penX);
+    AddCurvePoint(triangles, q[3], penX);
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+void TriangulateGlyph(const MySegment *segments, const int *contourEnds,
+                      int contourCount, float penX, ArenaVector<MyFillVertex> &triangles)
+{
+    // scratch space comes from the same arena as the triangles
+    ArenaVector<double> splits(triangles.get_allocator());
+
+    int begin = 0;
+    for (int c = 0; c < contourCount; begin = contourEnds[c++])
+    {
+        const MySegment *contour = segments + begin;
+        int size = contourEnds[c] - begin;
+        if (size <= 0) continue;
+
+        // every chord is fanned from the start of the contour
+        float ax = contour[0].x[0];
+        float ay = contour[0].y[0];
+
+        for (int s = 0; s < size; ++s)
+        {
+            const MySegment &segment = contour[s];
+
+            if (segment.degree == 1)
+            {
+                AddFan(triangles, ax, ay, segment.x[0], segment.y[0],
+                       segment.x[1], segment.y[1], penX);
+            }
+            else if (segment.degree == 2)
+            {
+                AddFan(triangles, ax, ay, segment.x[0], segment.y[0],
+                       segment.x[2], segment.y[2], penX);
+
+                // (u,v) = (0,0), (1/2,0), (1,1) makes the curve u^2 - v = 0
+                AddVertex(triangles, segment.x[0], segment.y[0], 0.0, 0, 0, 2, penX);
+                AddVertex(triangles, segment.x[1], segment.y[1], 0.5, 0, 0, 2, penX);
+                AddVertex(triangles, segment.x[2], segment.y[2], 1.0, 1, 0, 2, penX);
+            }
+            else if (segment.degree == 3)
+            {
+                CurvePoint p[4];
+                for (int i = 0; i < 4; ++i) {
+                    p[i].x = segment.x[i];
+                    p[i].y = segment.y[i];
+                    p[i].k = p[i].l = p[i].m = 0;
+                }
+
+                splits.clear();
+                if (!ClassifyCubic(p, splits))
+                {
+                    // a straight cubic only contributes its chord
+                    AddFan(triangles, ax, ay, segment.x[0], segment.y[0],
+                           segment.x[3], segment.y[3], penX);
+                    continue;
+                }
+
+                // cut the cubic at each split parameter, rescaling the
+                // remaining parameters onto the right-hand piece
+                CurvePoint piece[4], left[4], right[4];
+                copy(p, p + 4, piece);
+                double start = 0;
+                for (size_t i = 0; i < splits.size(); ++i)
+                {
+                    if (splits[i] - start < CLASSIFY_EPSILON) continue;
+                    double t = (splits[i] - start) / (1 - start);
+                    Subdivide(piece, t, left, right);
+                    AddCubicPiece(triangles, left, ax, ay, penX, 0);
+                    copy(right, right + 4, piece);
+                    start = splits[i];
+                }
+                AddCubicPiece(triangles, piece, ax, ay, penX, 0);
+            }
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
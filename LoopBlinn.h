@@ -0,0 +1,45 @@
+// ==========================================================================
+// Resolution-Independent Curve Fill Support
+//  - after Loop & Blinn, "Resolution Independent Curve Rendering using
+//    Programmable Graphics Hardware" (SIGGRAPH 2005)
+//
+// This module turns glyph outlines into triangles for a stencil-then-cover
+// fill. Every contour becomes a fan of solid triangles over the chords of
+// its segments, and each curved segment adds triangles over its control
+// polygon that carry curve coordinates. The fragment stage evaluates the
+// implicit form of the curve from these coordinates, so the curved edge is
+// exact at any zoom regardless of how many vertices were emitted:
+//  - a quadratic uses (u,v) coordinates and is inside where u^2 - v < 0
+//  - a cubic uses (k,l,m) coordinates and is inside where k^3 - lm < 0
+// Cubics are classified (serpentine, cusp, loop, quadratic, line) and split
+// at inflections and double points so that each piece bounds a convex area.
+// ==========================================================================
+#ifndef LOOPBLINN_H
+#define LOOPBLINN_H
+
+#include <vector>
+
+#include "GlyphExtractor.h"
+#include "Arena.h"
+
+// --------------------------------------------------------------------------
+// A vertex of a stencil triangle: a position in EM units, the curve
+// coordinates (u,v,0) of a quadratic or (k,l,m) of a cubic, and the degree of
+// the curve the triangle belongs to (0 for solid fan triangles).
+struct MyFillVertex
+{
+    float x, y;
+    float k, l, m;
+    float degree;
+};
+
+// appends the stencil triangles that fill a glyph, with the glyph placed at
+// pen position penX, to the triangle list; the glyph is given as written by
+// GlyphExtractor::ExtractSegments, its contours back to back with the index
+// one past the last segment of each
+void TriangulateGlyph(const MySegment *segments, const int *contourEnds,
+                      int contourCount, float penX,
+                      ArenaVector<MyFillVertex> &triangles);
+
+// --------------------------------------------------------------------------
+#endif // LOOPBLINN_H
@@ -0,0 +1,105 @@
+// ==========================================================================
+// Native Outline Reader Test
+//  - checks the TrueType and CFF readers against FreeType
+//
+// Every bundled font is loaded twice, once read natively and once through
+// FreeType alone, and every glyph in it is extracted from both, including
+// those no character maps to. The segments, contour ends and advance must match exactly,
+// since both start from the same integer font units. The program prints
+// each mismatch and exits with a failure status if there was any.
+// ==========================================================================
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "GlyphExtractor.h"
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+struct MyExtracted
+{
+    vector<MySegment> segments;
+    vector<int> contourEnds;
+    float advance;
+};
+
+void Extract(const GlyphExtractor &face, unsigned int index, MyExtracted *out)
+{
+    int contours = 0;
+    int count = face.ExtractGlyphSegments(index, 0, 0, 0, 0, &contours, &out->advance);
+    out->segments.resize(max(count, 1));
+    out->contourEnds.resize(max(contours, 1));
+    count = face.ExtractGlyphSegments(index, &out->segments[0], out->segments.size(),
+                                      &out->contourEnds[0], out->contourEnds.size(),
+                                      &contours, &out->advance);
+    out->segments.resize(count);
+    out->contourEnds.resize(contours);
+}
+
+bool SameSegment(const MySegment &a, const MySegment &b)
+{
+    if (a.degree != b.degree) return false;
+    for (unsigned int i = 0; i <= a.degree && i < 4; ++i)
+        if (a.x[i] != b.x[i] || a.y[i] != b.y[i]) return false;
+    return true;
+}
+
+bool SameOutline(const MyExtracted &a, const MyExtracted &b)
+{
+    if (a.advance != b.advance || a.contourEnds != b.contourEnds ||
+        a.segments.size() != b.segments.size())
+        return false;
+    for (size_t i = 0; i < a.segments.size(); ++i)
+        if (!SameSegment(a.segments[i], b.segments[i])) return false;
+    return true;
+}
+
+// compares every glyph of one font, returning the number that differ, or -1
+// if the font could not be loaded
+int TestFont(const string &filename)
+{
+    GlyphExtractor native, reference;
+    if (!native.LoadFontFile(filename) || !reference.LoadFontFile(filename, false))
+        return -1;
+
+    int failed = 0;
+    MyExtracted a, b;
+    for (int index = 0; index < native.GlyphCount(); ++index)
+    {
+        Extract(native, index, &a);
+        Extract(reference, index, &b);
+        if (!SameOutline(a, b)) {
+            ++failed;
+            cout << filename << ": glyph " << index << " differs from FreeType" << endl;
+        }
+    }
+
+    cout << filename << ": " << native.GlyphCount() << " glyphs, " << failed << " differ" << endl;
+    return failed;
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+int main()
+{
+    const char *fonts[] = { "Lora-Regular.ttf", "AlexBrush-Regular.ttf",
+                            "SourceSansPro-Regular.otf", "Inconsolata.otf" };
+
+    bool passed = true;
+    for (int i = 0; i < 4; ++i) {
+        int failed = TestFont(fonts[i]);
+        if (failed < 0)
+            cout << "ERROR: could not load " << fonts[i] << endl;
+        passed = passed && failed == 0;
+    }
+
+    cout << (passed ? "PASSED" : "FAILED") << endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+// ==========================================================================
+// Flattened Outline Cache
+// ==========================================================================
+
+#include "OutlineCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+// most steps a single curve is cut into, however large it is drawn
+const int MAX_STEPS = 256;
+
+void AddPoint(MyFlatOutline *outline, float x, float y)
+{
+    outline->points.push_back(x);
+    outline->points.push_back(y);
+}
+
+float SecondDifference(const float *x, const float *y, int i)
+{
+    float dx = x[i] - 2 * x[i + 1] + x[i + 2];
+    float dy = y[i] - 2 * y[i + 1] + y[i + 2];
+    return sqrt(dx * dx + dy * dy);
+}
+
+// appends the points of a segment after its start, already in pixels, in
+// equal steps of its parameter; a curve of degree n with second differences
+// of at most d strays from chords of step 1/k by n(n-1)d / 8k^2
+void FlattenSegment(MyFlatOutline *outline, const float *x, const float *y, int degree)
+{
+    int steps = 1;
+    if (degree >= 2) {
+        float d = SecondDifference(x, y, 0);
+        if (degree == 3)
+            d = max(d, SecondDifference(x, y, 1));
+        float k = sqrt(degree * (degree - 1) * d / (8 * FLATTEN_TOLERANCE));
+        steps = min(max(int(ceil(k)), 1), MAX_STEPS);
+    }
+
+    for (int i = 1; i <= steps; i++) {
+        float t = float(i) / steps, s = 1 - t;
+        if (degree == 2)
+            AddPoint(outline, s * s * x[0] + 2 * s * t * x[1] + t * t * x[2],
+                              s * s * y[0] + 2 * s * t * y[1] + t * t * y[2]);
+        else if (degree == 3)
+            AddPoint(outline, s * s * s * x[0] + 3 * s * s * t * x[1] + 3 * s * t * t * x[2] + t * t * t * x[3],
+                              s * s * s * y[0] + 3 * s * s * t * y[1] + 3 * s * t * t * y[2] + t * t * t * y[3]);
+        else
+            AddPoint(outline, x[degree], y[degree]);
+    }
+}
+
+size_t Bytes(const MyFlatOutline &outline)
+{
+    return sizeof(MyFlatKey) + sizeof(MyFlatOutline) +
+           outline.points.size() * sizeof(float) + outline.contourEnds.size() * sizeof(int);
+}
+
+} // namespace
+
+size_t MyFlatKeyHash::operator()(const MyFlatKey &key) const
+{
+    size_t h = hash<const void *>()(key.face);
+    h = h * 31 + key.glyph;
+    h = h * 31 + key.scale;
+    return h * 31 + key.subpixel;
+}
+
+MyFlatKey FlatKey(const GlyphExtractor *face, unsigned int glyph, float emPixels, float originX)
+{
+    float fraction = originX - floor(originX);
+    MyFlatKey key = { face, glyph, int(emPixels / SCALE_STEP + 0.5f),
+                      min(int(fraction * SUBPIXEL_BUCKETS), SUBPIXEL_BUCKETS - 1) };
+    return key;
+}
+
+const MyFlatOutline *FindFlatOutline(MyFlatCache *cache, const MyFlatKey &key)
+{
+    unordered_map<MyFlatKey, MyFlatCache::MyFlatList::iterator, MyFlatKeyHash>::iterator found =
+        cache->lookup.find(key);
+    if (found == cache->lookup.end()) {
+        cache->misses++;
+        return 0;
+    }
+
+    cache->hits++;
+    cache->entries.splice(cache->entries.begin(), cache->entries, found->second);
+    return &found->second->second;
+}
+
+const MyFlatOutline *AddFlatOutline(MyFlatCache *cache, const MyFlatKey &key, const MySegment *segments,
+                                    const int *contourEnds, int contourCount)
+{
+    // the polyline is placed at the middle of the key's bucket, so it is
+    // within half a bucket of where the glyph is drawn
+    float scale = key.scale * SCALE_STEP;
+    float shift = (key.subpixel + 0.5f) / SUBPIXEL_BUCKETS;
+
+    MyFlatOutline outline;
+    int begin = 0;
+    for (int c = 0; c < contourCount; c++) {
+        bool started = false;
+        for (int i = begin; i < contourEnds[c]; i++) {
+            const MySegment &segment = segments[i];
+            if (segment.degree == 0)
+                continue;
+
+            float x[4], y[4];
+            for (unsigned int j = 0; j <= segment.degree; j++) {
+                x[j] = segment.x[j] * scale + shift;
+                y[j] = segment.y[j] * scale;
+            }
+            if (!started)
+                AddPoint(&outline, x[0], y[0]);
+            started = true;
+            FlattenSegment(&outline, x, y, segment.degree);
+        }
+        outline.contourEnds.push_back(outline.points.size() / 2);
+        begin = contourEnds[c];
+    }
+
+    // replace a stale entry for the same key, if one is still cached
+    unordered_map<MyFlatKey, MyFlatCache::MyFlatList::iterator, MyFlatKeyHash>::iterator found =
+        cache->lookup.find(key);
+    if (found != cache->lookup.end()) {
+        cache->used -= Bytes(found->second->second);
+        cache->entries.erase(found->second);
+        cache->lookup.erase(found);
+    }
+
+    cache->used += Bytes(outline);
+    cache->entries.push_front(make_pair(key, MyFlatOutline()));
+    cache->entries.front().second.points.swap(outline.points);
+    cache->entries.front().second.contourEnds.swap(outline.contourEnds);
+    cache->lookup[key] = cache->entries.begin();
+
+    // the newest entry is kept even if it alone is over the budget
+    while (cache->used > cache->budget && cache->entries.size() > 1) {
+        cache->used -= Bytes(cache->entries.back().second);
+        cache->lookup.erase(cache->entries.back().first);
+        cache->entries.pop_back();
+        cache->evictions++;
+    }
+
+    return &cache->entries.front().second;
+}
+
+bool InsideFlatOutline(const MyFlatOutline *outline, float x, float y)
+{
+    const vector<float> &p = outline->points;
+    int winding = 0;
+    int begin = 0;
+
+    for (size_t c = 0; c < outline->contourEnds.size(); c++) {
+        int end = outline->contourEnds[c];
+        for (int i = begin; i < end; i++) {
+            // each edge, including the one closing the contour, that crosses
+            // the horizontal line through the point to its right
+            int j = (i + 1 < end) ? i + 1 : begin;
+            float x0 = p[2 * i], y0 = p[2 * i + 1];
+            float x1 = p[2 * j], y1 = p[2 * j + 1];
+            if ((y0 <= y) == (y1 <= y))
+                continue;
+            float cross = (x1 - x0) * (y - y0) - (x - x0) * (y1 - y0);
+            if (y1 > y0 && cross > 0)
+                winding++;
+            else if (y1 < y0 && cross < 0)
+                winding--;
+        }
+        begin = end;
+    }
+
+    return winding != 0;
+}
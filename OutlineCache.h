@@ -0,0 +1,109 @@
+// ==========================================================================
+// Flattened Outline Cache
+//  - keeps glyph outlines flattened to polylines at the sizes they are used
+//
+// How a glyph flattens depends on its face, its glyph index, the size it is
+// drawn at and where its origin falls within a pixel, so a polyline is
+// cached under all four: the size in steps of SCALE_STEP pixels per EM and
+// the origin in one of SUBPIXEL_BUCKETS positions across a pixel. Each curve
+// is cut into as few equal steps in its parameter as keep the chords within
+// FLATTEN_TOLERANCE pixels of it, by Wang's bound on the second derivative.
+// Entries are kept in least recently used order, and the oldest are evicted
+// once the cache holds more than its byte budget; lookups are counted so the
+// hit rate can be checked.
+// ==========================================================================
+#ifndef OUTLINECACHE_H
+#define OUTLINECACHE_H
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "GlyphExtractor.h"
+
+// --------------------------------------------------------------------------
+
+// steps the size of a glyph is quantised to, in pixels per EM
+const float SCALE_STEP = 0.25f;
+
+// number of positions across a pixel the origin of a glyph is snapped to
+const int SUBPIXEL_BUCKETS = 4;
+
+// how far a polyline may stray from the curves it replaces, in pixels
+const float FLATTEN_TOLERANCE = 0.125f;
+
+struct MyFlatKey
+{
+    const GlyphExtractor *face;
+    unsigned int glyph;
+
+    // size in steps of SCALE_STEP, and the bucket of the origin's offset
+    // from the left edge of its pixel
+    int scale;
+    int subpixel;
+
+    bool operator==(const MyFlatKey &other) const
+    {
+        return face == other.face && glyph == other.glyph &&
+               scale == other.scale && subpixel == other.subpixel;
+    }
+};
+
+struct MyFlatKeyHash
+{
+    size_t operator()(const MyFlatKey &key) const;
+};
+
+struct MyFlatOutline
+{
+    // x and y of the points of every contour back to back, in pixels from
+    // the left edge of the pixel the glyph's origin falls in and from its
+    // baseline, and the index one past the last point of each contour
+    std::vector<float> points;
+    std::vector<int> contourEnds;
+};
+
+struct MyFlatCache
+{
+    // bytes of polylines the cache may hold, and holds now
+    size_t budget;
+    size_t used;
+
+    // lookups that found an entry and that did not, and entries evicted
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+
+    // entries from the most to the least recently used, and where each is
+    typedef std::list<std::pair<MyFlatKey, MyFlatOutline> > MyFlatList;
+    MyFlatList entries;
+    std::unordered_map<MyFlatKey, MyFlatList::iterator, MyFlatKeyHash> lookup;
+
+    MyFlatCache(size_t bytes = 256 * 1024)
+        : budget(bytes), used(0), hits(0), misses(0), evictions(0)
+    {}
+};
+
+// the key of a glyph drawn at emPixels pixels per EM with its origin
+// originX pixels from the left of the window
+MyFlatKey FlatKey(const GlyphExtractor *face, unsigned int glyph, float emPixels, float originX);
+
+// returns the cached polyline for a key, making it the most recently used,
+// or null if it is not cached; either way the lookup is counted
+const MyFlatOutline *FindFlatOutline(MyFlatCache *cache, const MyFlatKey &key);
+
+// flattens an outline given in EM units, as written by
+// GlyphExtractor::ExtractSegments, at the size and origin of the key and
+// caches it, evicting the least recently used entries beyond the budget;
+// the polyline returned stays valid until the next call
+const MyFlatOutline *AddFlatOutline(MyFlatCache *cache, const MyFlatKey &key, const MySegment *segments,
+                                    const int *contourEnds, int contourCount);
+
+// whether a point, in the pixels of a polyline, is inside it by the nonzero
+// winding rule that TrueType and CFF outlines are filled with
+bool InsideFlatOutline(const MyFlatOutline *outline, float x, float y);
+
+// --------------------------------------------------------------------------
+#endif // OUTLINECACHE_H
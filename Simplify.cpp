@@ -0,0 +1,210 @@
+// ==========================================================================
+// Outline Simplification
+// ==========================================================================
+
+#include "Simplify.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+// distance from point p to the line segment from a to b
+float SegmentDistance(float px, float py, float ax, float ay, float bx, float by)
+{
+    float dx = bx - ax, dy = by - ay;
+    float length2 = dx * dx + dy * dy;
+    float t = 0;
+    if (length2 > 0)
+        t = min(max(((px - ax) * dx + (py - ay) * dy) / length2, 0.0f), 1.0f);
+    float ex = ax + t * dx - px, ey = ay + t * dy - py;
+    return sqrt(ex * ex + ey * ey);
+}
+
+// greatest distance of a segment's control points from its start
+float Extent(const MySegment &segment)
+{
+    float extent = 0;
+    for (unsigned int i = 1; i <= segment.degree; ++i)
+    {
+        float dx = segment.x[i] - segment.x[0], dy = segment.y[i] - segment.y[0];
+        extent = max(extent, sqrt(dx * dx + dy * dy));
+    }
+    return extent;
+}
+
+// number of pieces a curve is cut into where it is measured against another
+const int CURVE_SAMPLES = 16;
+
+// the point at parameter t of a segment
+void Evaluate(const MySegment &segment, float t, float *x, float *y)
+{
+    float s = 1 - t;
+    const float *px = segment.x, *py = segment.y;
+    switch (segment.degree)
+    {
+    case 1:
+        *x = s * px[0] + t * px[1];
+        *y = s * py[0] + t * py[1];
+        break;
+    case 2:
+        *x = s * s * px[0] + 2 * s * t * px[1] + t * t * px[2];
+        *y = s * s * py[0] + 2 * s * t * py[1] + t * t * py[2];
+        break;
+    case 3:
+        *x = s * s * s * px[0] + 3 * s * s * t * px[1] + 3 * s * t * t * px[2] + t * t * t * px[3];
+        *y = s * s * s * py[0] + 3 * s * s * t * py[1] + 3 * s * t * t * py[2] + t * t * t * py[3];
+        break;
+    default:
+        *x = px[0];
+        *y = py[0];
+    }
+}
+
+// greatest distance from a replacement segment of any point of the input
+// segments first to last that it stands in for; curves on either side are
+// measured at CURVE_SAMPLES steps, and lines at their ends, since the
+// distance to a line is greatest at one end of any straight piece
+float Deviation(const MySegment &replacement, const MySegment *in, int first, int last)
+{
+    float rx[CURVE_SAMPLES + 1], ry[CURVE_SAMPLES + 1];
+    int pieces = (replacement.degree > 1) ? CURVE_SAMPLES : 1;
+    for (int k = 0; k <= pieces; ++k)
+        Evaluate(replacement, float(k) / pieces, &rx[k], &ry[k]);
+
+    float deviation = 0;
+    for (int j = first; j <= last; ++j)
+    {
+        if (in[j].degree < 1 || in[j].degree > 3)
+            continue;
+        int samples = (in[j].degree > 1) ? CURVE_SAMPLES : 1;
+        for (int k = 0; k <= samples; ++k)
+        {
+            float x, y;
+            Evaluate(in[j], float(k) / samples, &x, &y);
+            float distance = SegmentDistance(x, y, rx[0], ry[0], rx[1], ry[1]);
+            for (int r = 1; r < pieces; ++r)
+                distance = min(distance, SegmentDistance(x, y, rx[r], ry[r], rx[r + 1], ry[r + 1]));
+            deviation = max(deviation, distance);
+        }
+    }
+    return deviation;
+}
+
+// Every segment written ends where one of the input segments ends, and the
+// segment after it starts exactly there, so the contour stays joined even
+// where the font's own segments only meet to within rounding. A replacement
+// is only accepted if it stays within the tolerance of every input segment
+// it stands in for, measured against the segment as finally written, so
+// errors cannot build up over successive merges.
+int SimplifyContour(const MySegment *in, int count, float tolerance, MySegment *out)
+{
+    int kept = 0;
+
+    // first input segment replaced by the segment last written, and the
+    // first input segment not yet replaced
+    int covered = 0;
+    int pending = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        const MySegment &segment = in[i];
+        int d = segment.degree;
+
+        // segments too small to see are left for the next one written to
+        // take in; the last one is never left, so the contour stays closed
+        if (i + 1 < count && (d < 1 || d > 3 || Extent(segment) <= tolerance))
+            continue;
+
+        // a line over everything not yet replaced, from the end of the
+        // segment last written
+        MySegment line(1);
+        line.x[0] = (kept > 0) ? out[kept - 1].x[out[kept - 1].degree] : in[pending].x[0];
+        line.y[0] = (kept > 0) ? out[kept - 1].y[out[kept - 1].degree] : in[pending].y[0];
+        line.x[1] = segment.x[(d >= 1 && d <= 3) ? d : 0];
+        line.y[1] = segment.y[(d >= 1 && d <= 3) ? d : 0];
+
+        // extend the previous line instead if it stays close to everything
+        // both it and the new line replace
+        if (kept > 0 && out[kept - 1].degree == 1)
+        {
+            MySegment longer = out[kept - 1];
+            longer.x[1] = line.x[1];
+            longer.y[1] = line.y[1];
+            if (Deviation(longer, in, covered, i) <= tolerance)
+            {
+                out[kept - 1] = longer;
+                pending = i + 1;
+                continue;
+            }
+        }
+
+        if (Deviation(line, in, pending, i) <= tolerance)
+        {
+            out[kept++] = line;
+            covered = pending;
+            pending = i + 1;
+            continue;
+        }
+
+        // keep the curve, taking in any small segments before it by moving
+        // its start back to theirs, if that stays close to them
+        MySegment moved = segment;
+        moved.x[0] = line.x[0];
+        moved.y[0] = line.y[0];
+        if (d > 1 && d <= 3 && Deviation(moved, in, pending, i) <= tolerance)
+        {
+            out[kept++] = moved;
+            covered = pending;
+            pending = i + 1;
+            continue;
+        }
+
+        // otherwise nothing since the last segment written is dropped
+        for (int j = pending; j <= i; ++j)
+        {
+            if (in[j].degree < 1 || in[j].degree > 3)
+                continue;
+            float x0 = (kept > 0) ? out[kept - 1].x[out[kept - 1].degree] : in[j].x[0];
+            float y0 = (kept > 0) ? out[kept - 1].y[out[kept - 1].degree] : in[j].y[0];
+            out[kept] = in[j];
+            out[kept].x[0] = x0;
+            out[kept].y[0] = y0;
+            kept++;
+            covered = j;
+        }
+        pending = i + 1;
+    }
+
+    // a contour needs two segments to enclose anything
+    if (kept < 2)
+        return 0;
+
+    // the last segment written ends where the contour does, which is where
+    // it started to within rounding
+    out[0].x[0] = out[kept - 1].x[out[kept - 1].degree];
+    out[0].y[0] = out[kept - 1].y[out[kept - 1].degree];
+    return kept;
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+int SimplifyOutline(const MySegment *segments, const int *contourEnds, int contourCount,
+                    float tolerance, MySegment *out, int *outEnds)
+{
+    int written = 0;
+    int begin = 0;
+    for (int c = 0; c < contourCount; begin = contourEnds[c++])
+    {
+        written += SimplifyContour(segments + begin, contourEnds[c] - begin, tolerance,
+                                   out + written);
+        outEnds[c] = written;
+    }
+    return written;
+}
@@ -0,0 +1,30 @@
+// ==========================================================================
+// Outline Simplification
+//  - removes detail too small to see from glyph outlines
+//
+// An outline is simplified to a tolerance in its own units: segments whose
+// control points all lie within the tolerance of their start are dropped,
+// curves that stay within it of their chord become lines, and runs of lines
+// are merged into one for as long as the merged line stays within it of
+// every segment it replaces. Each replacement is measured against the input
+// segments themselves, sampled along any curves, so the error never builds
+// up past the tolerance however many merges follow. The segments kept meet
+// end to end, so every contour stays closed; contours that shrink to fewer
+// than two segments vanish.
+// ==========================================================================
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include "GlyphExtractor.h"
+
+// --------------------------------------------------------------------------
+
+// writes a simplified copy of an outline, given as contours stored back to
+// back with the index one past the end of each, to out and outEnds, which
+// need room for as many segments and contours as the input; returns the
+// number of segments written
+int SimplifyOutline(const MySegment *segments, const int *contourEnds, int contourCount,
+                    float tolerance, MySegment *out, int *outEnds);
+
+// --------------------------------------------------------------------------
+#endif // SIMPLIFY_H
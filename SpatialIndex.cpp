@@ -0,0 +1,140 @@
+// ==========================================================================
+// Spatial Index of Glyph Boxes
+// ==========================================================================
+
+#include "SpatialIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+int Cell(const MySpatialIndex *index, float x)
+{
+    return int(floor(x / index->cellSize));
+}
+
+long long CellKey(int column, int row)
+{
+    return (static_cast<long long>(row) << 32) | static_cast<unsigned int>(column);
+}
+
+bool Overlaps(const MyBounds &a, const MyBounds &b)
+{
+    return a.xMin <= b.xMax && a.xMax >= b.xMin && a.yMin <= b.yMax && a.yMax >= b.yMin;
+}
+
+// reports a box overlapping the range from the one cell that holds the lower
+// left corner of their overlap, which lies in both
+void Collect(const MySpatialIndex *index, int column, int row, const vector<int> &cell,
+             const MyBounds &range, ArenaVector<int> &ids)
+{
+    for (size_t i = 0; i < cell.size(); i++) {
+        const MyBounds &box = index->boxes[cell[i]];
+        if (!Overlaps(box, range))
+            continue;
+        if (Cell(index, max(box.xMin, range.xMin)) == column &&
+            Cell(index, max(box.yMin, range.yMin)) == row)
+            ids.push_back(cell[i]);
+    }
+}
+
+// takes the box of the given id out of the cells it is filed under, if it
+// has one
+void RemoveBox(MySpatialIndex *index, int id)
+{
+    if (id < 0 || id >= int(index->boxes.size()) || index->boxes[id].Empty())
+        return;
+
+    const MyBounds &bounds = index->boxes[id];
+    int c0 = Cell(index, bounds.xMin), c1 = Cell(index, bounds.xMax);
+    int r0 = Cell(index, bounds.yMin), r1 = Cell(index, bounds.yMax);
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            unordered_map<long long, vector<int> >::iterator found = index->cells.find(CellKey(c, r));
+            if (found == index->cells.end())
+                continue;
+            vector<int> &cell = found->second;
+            vector<int>::iterator slot = find(cell.begin(), cell.end(), id);
+            if (slot != cell.end()) {
+                *slot = cell.back();
+                cell.pop_back();
+            }
+            if (cell.empty())
+                index->cells.erase(found);
+        }
+    }
+
+    // the extent is left as it is; it only has to cover the boxes remaining
+    index->boxes[id] = MyBounds();
+}
+
+} // namespace
+
+void InsertBox(MySpatialIndex *index, int id, const MyBounds &bounds)
+{
+    RemoveBox(index, id);
+    if (bounds.Empty())
+        return;
+
+    if (id >= int(index->boxes.size()))
+        index->boxes.resize(id + 1);
+    index->boxes[id] = bounds;
+
+    int c0 = Cell(index, bounds.xMin), c1 = Cell(index, bounds.xMax);
+    int r0 = Cell(index, bounds.yMin), r1 = Cell(index, bounds.yMax);
+    for (int r = r0; r <= r1; r++)
+        for (int c = c0; c <= c1; c++)
+            index->cells[CellKey(c, r)].push_back(id);
+
+    GrowBounds(index->extent, bounds.xMin, bounds.yMin);
+    GrowBounds(index->extent, bounds.xMax, bounds.yMax);
+}
+
+void ClearIndex(MySpatialIndex *index)
+{
+    index->boxes.clear();
+    index->cells.clear();
+    index->extent = MyBounds();
+}
+
+void QueryRange(const MySpatialIndex *index, const MyBounds &range, ArenaVector<int> &ids)
+{
+    // nothing lies outside the extent, so a range reaching past it (or one
+    // drawn around everything) covers no more cells than the boxes do
+    MyBounds clipped;
+    clipped.xMin = max(range.xMin, index->extent.xMin);
+    clipped.yMin = max(range.yMin, index->extent.yMin);
+    clipped.xMax = min(range.xMax, index->extent.xMax);
+    clipped.yMax = min(range.yMax, index->extent.yMax);
+    if (range.Empty() || index->extent.Empty() || clipped.Empty())
+        return;
+
+    int c0 = Cell(index, clipped.xMin), c1 = Cell(index, clipped.xMax);
+    int r0 = Cell(index, clipped.yMin), r1 = Cell(index, clipped.yMax);
+
+    // a range spanning more cells than are occupied is cheaper to answer by
+    // going through the occupied ones
+    if (double(c1 - c0 + 1) * (r1 - r0 + 1) > index->cells.size()) {
+        unordered_map<long long, vector<int> >::const_iterator it;
+        for (it = index->cells.begin(); it != index->cells.end(); ++it) {
+            int column = static_cast<int>(it->first & 0xFFFFFFFF);
+            int row = static_cast<int>(it->first >> 32);
+            if (column >= c0 && column <= c1 && row >= r0 && row <= r1)
+                Collect(index, column, row, it->second, clipped, ids);
+        }
+        return;
+    }
+
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            unordered_map<long long, vector<int> >::const_iterator found = index->cells.find(CellKey(c, r));
+            if (found != index->cells.end())
+                Collect(index, c, r, found->second, clipped, ids);
+        }
+    }
+}
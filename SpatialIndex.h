@@ -0,0 +1,53 @@
+// ==========================================================================
+// Spatial Index of Glyph Boxes
+//  - answers which glyphs overlap a rectangle or a point
+//
+// Boxes are filed in a uniform grid of square cells, each box under every
+// cell it overlaps. Only occupied cells are stored, in a hash map keyed by
+// the cell's column and row, so the grid has no fixed extent; filing a box
+// under an id it already has moves it. A query visits just the cells it
+// covers; a box listed under several of them is reported once, from the
+// cell holding the lower left corner of its overlap with the query.
+// ==========================================================================
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "Arena.h"
+#include "GlyphExtractor.h"
+
+// --------------------------------------------------------------------------
+
+struct MySpatialIndex
+{
+    // side of a grid cell; about one glyph per cell keeps queries short
+    float cellSize;
+
+    // box of each id, empty for ids not in the index; ids are meant to be
+    // small and dense, like the position of a glyph in its text
+    std::vector<MyBounds> boxes;
+
+    // ids of the boxes overlapping each occupied cell
+    std::unordered_map<long long, std::vector<int> > cells;
+
+    // box covering every cell that has been occupied, which bounds queries
+    MyBounds extent;
+
+    MySpatialIndex(float size = 1) : cellSize(size)
+    {}
+};
+
+// files a box under the given id, replacing any box it had
+void InsertBox(MySpatialIndex *index, int id, const MyBounds &bounds);
+
+// empties the index, keeping its cell size
+void ClearIndex(MySpatialIndex *index);
+
+// appends the id of every box overlapping the range to ids, each once and in
+// no particular order
+void QueryRange(const MySpatialIndex *index, const MyBounds &range, ArenaVector<int> &ids);
+
+// --------------------------------------------------------------------------
+#endif // SPATIALINDEX_H
@@ -0,0 +1,455 @@
+// ==========================================================================
+// Native TrueType Outline Reader
+// ==========================================================================
+
+#include "TrueType.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+// composite glyphs may nest, but not without limit
+const int MAX_COMPONENT_DEPTH = 8;
+
+// FT_Outline counts its points in a short
+const int MAX_POINTS = 32767;
+
+// simple glyph flags
+const int ON_CURVE_POINT = 0x01;
+const int X_SHORT_VECTOR = 0x02;
+const int Y_SHORT_VECTOR = 0x04;
+const int REPEAT_FLAG = 0x08;
+const int X_IS_SAME_OR_POSITIVE = 0x10;
+const int Y_IS_SAME_OR_POSITIVE = 0x20;
+
+// composite glyph flags
+const int ARG_1_AND_2_ARE_WORDS = 0x0001;
+const int ARGS_ARE_XY_VALUES = 0x0002;
+const int WE_HAVE_A_SCALE = 0x0008;
+const int MORE_COMPONENTS = 0x0020;
+const int WE_HAVE_AN_X_AND_Y_SCALE = 0x0040;
+const int WE_HAVE_A_TWO_BY_TWO = 0x0080;
+const int USE_MY_METRICS = 0x0200;
+const int SCALED_COMPONENT_OFFSET = 0x0800;
+const int UNSCALED_COMPONENT_OFFSET = 0x1000;
+
+// big-endian reads from a range of the file that has already been checked
+unsigned int Read16(const unsigned char *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+unsigned int Read32(const unsigned char *p)
+{
+    return (unsigned(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+int ReadSigned16(const unsigned char *p)
+{
+    return short(Read16(p));
+}
+
+// a read position that never moves past the end of its range
+struct Cursor
+{
+    const unsigned char *at;
+    const unsigned char *end;
+
+    bool Has(size_t bytes) const { return size_t(end - at) >= bytes; }
+};
+
+// finds a table by tag in the offset table, checking that it lies in the file
+bool FindTable(const MyTrueTypeFont *font, const char *tag, size_t *offset, size_t *length)
+{
+    if (font->size < 12) return false;
+    unsigned int tableCount = Read16(font->data + 4);
+    if (12 + 16 * size_t(tableCount) > font->size) return false;
+
+    for (unsigned int i = 0; i < tableCount; ++i)
+    {
+        const unsigned char *record = font->data + 12 + 16 * i;
+        if (memcmp(record, tag, 4) != 0) continue;
+
+        *offset = Read32(record + 8);
+        *length = Read32(record + 12);
+        return *offset <= font->size && *length <= font->size - *offset;
+    }
+    return false;
+}
+
+// advance width of a glyph, in font units
+int AdvanceWidth(const MyTrueTypeFont *font, unsigned int glyphIndex)
+{
+    if (font->metricCount == 0) return 0;
+    if (glyphIndex >= unsigned(font->metricCount)) glyphIndex = font->metricCount - 1;
+    return Read16(font->data + font->hmtx + 4 * glyphIndex);
+}
+
+// left side bearing of a glyph, in font units; glyphs past the last full
+// metric keep only their bearing, in an array after the metrics
+int LeftBearing(const MyTrueTypeFont *font, unsigned int glyphIndex)
+{
+    size_t offset;
+    if (glyphIndex < unsigned(font->metricCount))
+        offset = 4 * size_t(glyphIndex) + 2;
+    else
+        offset = 4 * size_t(font->metricCount) + 2 * size_t(glyphIndex - font->metricCount);
+    if (offset + 2 > font->hmtxLength) return 0;
+    return ReadSigned16(font->data + font->hmtx + offset);
+}
+
+// finds the glyf data of a glyph, which is empty for glyphs with no outline
+bool GlyphData(const MyTrueTypeFont *font, unsigned int glyphIndex, Cursor *data)
+{
+    if (glyphIndex >= unsigned(font->glyphCount)) return false;
+
+    const unsigned char *loca = font->data + font->loca;
+    size_t begin, end;
+    if (font->longOffsets) {
+        begin = Read32(loca + 4 * glyphIndex);
+        end = Read32(loca + 4 * glyphIndex + 4);
+    }
+    else {
+        begin = 2 * size_t(Read16(loca + 2 * glyphIndex));
+        end = 2 * size_t(Read16(loca + 2 * glyphIndex + 2));
+    }
+    if (begin > end || end > font->glyfLength) return false;
+
+    data->at = font->data + font->glyf + begin;
+    data->end = font->data + font->glyf + end;
+    return true;
+}
+
+// appends the points, tags and contour ends of a simple glyph
+bool LoadSimpleGlyph(MyTrueTypeFont *font, Cursor data, int contourCount)
+{
+    size_t base = font->points.size();
+
+    if (!data.Has(2 * contourCount + 2)) return false;
+    int pointCount = 0;
+    for (int c = 0; c < contourCount; ++c)
+    {
+        int end = Read16(data.at + 2 * c);
+        if (end < pointCount - 1) return false;
+        pointCount = end + 1;
+        font->contours.push_back(base + end);
+    }
+    data.at += 2 * contourCount;
+    if (base + pointCount > size_t(MAX_POINTS)) return false;
+
+    // skip the hinting instructions
+    size_t instructionLength = Read16(data.at);
+    data.at += 2;
+    if (!data.Has(instructionLength)) return false;
+    data.at += instructionLength;
+
+    // flags, with runs of the same flag stored once plus a repeat count
+    font->points.resize(base + pointCount);
+    font->tags.resize(base + pointCount);
+    vector<FT_Vector>::iterator points = font->points.begin() + base;
+    vector<MyOutlineTag>::iterator tags = font->tags.begin() + base;
+    for (int i = 0; i < pointCount; )
+    {
+        if (!data.Has(1)) return false;
+        int flag = *data.at++;
+        int repeat = 1;
+        if (flag & REPEAT_FLAG) {
+            if (!data.Has(1)) return false;
+            repeat += *data.at++;
+        }
+        for (; repeat > 0 && i < pointCount; --repeat, ++i)
+        {
+            // the flag is kept in x until the coordinates are read
+            tags[i] = (flag & ON_CURVE_POINT) ? FT_CURVE_TAG_ON : FT_CURVE_TAG_CONIC;
+            points[i].x = flag;
+        }
+    }
+
+    // x coordinates, then y coordinates, each stored as deltas
+    long x = 0;
+    for (int i = 0; i < pointCount; ++i)
+    {
+        int flag = points[i].x;
+        if (flag & X_SHORT_VECTOR) {
+            if (!data.Has(1)) return false;
+            int delta = *data.at++;
+            x += (flag & X_IS_SAME_OR_POSITIVE) ? delta : -delta;
+        }
+        else if (!(flag & X_IS_SAME_OR_POSITIVE)) {
+            if (!data.Has(2)) return false;
+            x += ReadSigned16(data.at);
+            data.at += 2;
+        }
+        points[i].x = x;
+
+        // the y flags move into y for the second pass
+        points[i].y = flag;
+    }
+
+    long y = 0;
+    for (int i = 0; i < pointCount; ++i)
+    {
+        int flag = points[i].y;
+        if (flag & Y_SHORT_VECTOR) {
+            if (!data.Has(1)) return false;
+            int delta = *data.at++;
+            y += (flag & Y_IS_SAME_OR_POSITIVE) ? delta : -delta;
+        }
+        else if (!(flag & Y_IS_SAME_OR_POSITIVE)) {
+            if (!data.Has(2)) return false;
+            y += ReadSigned16(data.at);
+            data.at += 2;
+        }
+        points[i].y = y;
+    }
+
+    return true;
+}
+
+bool LoadGlyph(MyTrueTypeFont *font, unsigned int glyphIndex, int depth);
+
+// appends every component of a composite glyph, placed and transformed
+bool LoadCompositeGlyph(MyTrueTypeFont *font, Cursor data, int depth)
+{
+    if (depth >= MAX_COMPONENT_DEPTH) return false;
+
+    // point numbers in point matches count from the first point of this glyph
+    size_t start = font->points.size();
+
+    int flags;
+    do
+    {
+        if (!data.Has(4)) return false;
+        flags = Read16(data.at);
+        unsigned int component = Read16(data.at + 2);
+        data.at += 4;
+
+        // offset, or the indices of a parent point and a component point to
+        // bring together
+        int arg1, arg2;
+        if (flags & ARG_1_AND_2_ARE_WORDS) {
+            if (!data.Has(4)) return false;
+            arg1 = Read16(data.at);
+            arg2 = Read16(data.at + 2);
+            if (flags & ARGS_ARE_XY_VALUES) {
+                arg1 = short(arg1);
+                arg2 = short(arg2);
+            }
+            data.at += 4;
+        }
+        else {
+            if (!data.Has(2)) return false;
+            arg1 = data.at[0];
+            arg2 = data.at[1];
+            if (flags & ARGS_ARE_XY_VALUES) {
+                arg1 = (signed char)(arg1);
+                arg2 = (signed char)(arg2);
+            }
+            data.at += 2;
+        }
+
+        // 2x2 transform in F2Dot14
+        double a = 1, b = 0, c = 0, d = 1;
+        if (flags & WE_HAVE_A_SCALE) {
+            if (!data.Has(2)) return false;
+            a = d = ReadSigned16(data.at) / 16384.0;
+            data.at += 2;
+        }
+        else if (flags & WE_HAVE_AN_X_AND_Y_SCALE) {
+            if (!data.Has(4)) return false;
+            a = ReadSigned16(data.at) / 16384.0;
+            d = ReadSigned16(data.at + 2) / 16384.0;
+            data.at += 4;
+        }
+        else if (flags & WE_HAVE_A_TWO_BY_TWO) {
+            if (!data.Has(8)) return false;
+            a = ReadSigned16(data.at) / 16384.0;
+            b = ReadSigned16(data.at + 2) / 16384.0;
+            c = ReadSigned16(data.at + 4) / 16384.0;
+            d = ReadSigned16(data.at + 6) / 16384.0;
+            data.at += 8;
+        }
+        bool transformed = (a != 1 || b != 0 || c != 0 || d != 1);
+
+        size_t base = font->points.size();
+        int advance = font->advance;
+        long origin = font->origin;
+        if (!LoadGlyph(font, component, depth + 1)) return false;
+        bool useMetrics = (flags & USE_MY_METRICS) != 0;
+        if (!useMetrics) {
+            font->advance = advance;
+            font->origin = origin;
+        }
+
+        size_t end = font->points.size();
+        if (transformed)
+        {
+            for (size_t i = base; i < end; ++i)
+            {
+                FT_Vector &p = font->points[i];
+                double x = p.x, y = p.y;
+                p.x = long(a * x + c * y + (a * x + c * y < 0 ? -0.5 : 0.5));
+                p.y = long(b * x + d * y + (b * x + d * y < 0 ? -0.5 : 0.5));
+            }
+        }
+
+        long dx, dy;
+        if (flags & ARGS_ARE_XY_VALUES) {
+            dx = arg1;
+            dy = arg2;
+            if ((flags & SCALED_COMPONENT_OFFSET) && !(flags & UNSCALED_COMPONENT_OFFSET)) {
+                double x = dx, y = dy;
+                dx = long(a * x + c * y + (a * x + c * y < 0 ? -0.5 : 0.5));
+                dy = long(b * x + d * y + (b * x + d * y < 0 ? -0.5 : 0.5));
+            }
+        }
+        else {
+            if (start + arg1 >= base || base + arg2 >= end) return false;
+            dx = font->points[start + arg1].x - font->points[base + arg2].x;
+            dy = font->points[start + arg1].y - font->points[base + arg2].y;
+        }
+        for (size_t i = base; i < end; ++i) {
+            font->points[i].x += dx;
+            font->points[i].y += dy;
+        }
+    }
+    while (flags & MORE_COMPONENTS);
+
+    return true;
+}
+
+bool LoadGlyph(MyTrueTypeFont *font, unsigned int glyphIndex, int depth)
+{
+    Cursor data;
+    if (!GlyphData(font, glyphIndex, &data)) return false;
+    font->advance = AdvanceWidth(font, glyphIndex);
+    font->origin = 0;
+
+    // glyphs like the space have no data at all
+    if (data.at == data.end) return true;
+
+    // number of contours, then the bounding box; like FreeType, the origin
+    // is placed at the left side bearing from the left edge of the box
+    if (!data.Has(10)) return false;
+    int contourCount = ReadSigned16(data.at);
+    font->origin = ReadSigned16(data.at + 2) - LeftBearing(font, glyphIndex);
+    data.at += 10;
+
+    if (contourCount >= 0)
+        return LoadSimpleGlyph(font, data, contourCount);
+    return LoadCompositeGlyph(font, data, depth);
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+bool OpenTrueTypeFont(MyTrueTypeFont *font, const string &filename)
+{
+    CloseTrueTypeFont(font);
+
+    int file = open(filename.c_str(), O_RDONLY);
+    if (file < 0) return false;
+
+    struct stat info;
+    void *mapped = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0)
+        mapped = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapped == MAP_FAILED) return false;
+
+    font->data = static_cast<const unsigned char *>(mapped);
+    font->size = info.st_size;
+
+    size_t head, headLength, maxp, maxpLength, hhea, hheaLength;
+    if (!FindTable(font, "head", &head, &headLength) || headLength < 54 ||
+        !FindTable(font, "maxp", &maxp, &maxpLength) || maxpLength < 6 ||
+        !FindTable(font, "hhea", &hhea, &hheaLength) || hheaLength < 36 ||
+        !FindTable(font, "hmtx", &font->hmtx, &font->hmtxLength))
+    {
+        CloseTrueTypeFont(font);
+        return false;
+    }
+
+    font->unitsPerEM = Read16(font->data + head + 18);
+    font->longOffsets = ReadSigned16(font->data + head + 50) != 0;
+    font->glyphCount = Read16(font->data + maxp + 4);
+    font->metricCount = Read16(font->data + hhea + 34);
+    if (font->hmtxLength < 4 * size_t(font->metricCount)) {
+        CloseTrueTypeFont(font);
+        return false;
+    }
+
+    // outlines come from a glyf table, or failing that a CFF table
+    bool outlines;
+    size_t cff, cffLength;
+    if (FindTable(font, "glyf", &font->glyf, &font->glyfLength))
+    {
+        // the glyph count bounds every lookup, so check the table it indexes
+        size_t locaEntry = font->longOffsets ? 4 : 2;
+        outlines = FindTable(font, "loca", &font->loca, &font->locaLength) &&
+                   font->locaLength >= locaEntry * (font->glyphCount + 1);
+    }
+    else
+        outlines = FindTable(font, "CFF ", &cff, &cffLength) &&
+                   OpenCffTable(font, cff, cffLength);
+
+    if (!outlines) {
+        CloseTrueTypeFont(font);
+        return false;
+    }
+    return true;
+}
+
+void CloseTrueTypeFont(MyTrueTypeFont *font)
+{
+    if (font->data)
+        munmap(const_cast<unsigned char *>(font->data), font->size);
+    font->data = 0;
+    font->size = 0;
+    font->cff = MyCffFont();
+}
+
+bool LoadTrueTypeGlyph(MyTrueTypeFont *font, unsigned int glyphIndex)
+{
+    font->points.clear();
+    font->tags.clear();
+    font->contours.clear();
+    font->advance = 0;
+    if (!font->data) return false;
+
+    // CFF glyphs are drawn from their origin, and take their advance from
+    // hmtx like TrueType glyphs
+    if (font->cff.table) {
+        if (glyphIndex >= unsigned(font->glyphCount)) return false;
+        font->advance = AdvanceWidth(font, glyphIndex);
+        return LoadCffGlyph(font, glyphIndex);
+    }
+
+    if (!LoadGlyph(font, glyphIndex, 0)) return false;
+
+    if (font->origin != 0)
+        for (size_t i = 0; i < font->points.size(); ++i)
+            font->points[i].x -= font->origin;
+    return true;
+}
+
+FT_Outline TrueTypeOutline(MyTrueTypeFont *font)
+{
+    FT_Outline outline;
+    memset(&outline, 0, sizeof(outline));
+    outline.n_points = font->points.size();
+    outline.n_contours = font->contours.size();
+    outline.points = font->points.empty() ? 0 : &font->points[0];
+    outline.tags = font->tags.empty() ? 0 : &font->tags[0];
+    outline.contours = font->contours.empty() ? 0 : &font->contours[0];
+    return outline;
+}
@@ -0,0 +1,81 @@
+// ==========================================================================
+// Native TrueType Outline Reader
+//  - reads glyph outlines from the glyf table of a TrueType font directly
+//
+// The font file is mapped into memory and the head, maxp, hhea, hmtx, loca
+// and glyf tables are read where they lie, without going through
+// FT_Load_Glyph. Simple glyphs are decoded from their packed flags and
+// coordinates, and composite glyphs by loading each component in turn and
+// applying its offset or point match and its 2x2 transform. The result is
+// left in font units in arrays laid out like FreeType's FT_Outline, which
+// are reused from glyph to glyph, so that the same contour conversion serves
+// both paths. Fonts with CFF outlines have no glyf table, and are read
+// through the CFF module instead.
+// ==========================================================================
+#ifndef TRUETYPE_H
+#define TRUETYPE_H
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "Cff.h"
+
+// element types of the FT_Outline arrays, which vary between FreeType versions
+typedef std::remove_pointer<decltype(FT_Outline::tags)>::type MyOutlineTag;
+typedef std::remove_pointer<decltype(FT_Outline::contours)>::type MyOutlineContour;
+
+// --------------------------------------------------------------------------
+
+struct MyTrueTypeFont
+{
+    // the mapped font file, or null if none is open
+    const unsigned char *data;
+    size_t size;
+
+    // offsets and lengths of the tables read from the file
+    size_t glyf, glyfLength;
+    size_t loca, locaLength;
+    size_t hmtx, hmtxLength;
+
+    int unitsPerEM;
+    int glyphCount;
+    int metricCount;
+    bool longOffsets;
+
+    // charstrings and subroutines of fonts with CFF outlines
+    MyCffFont cff;
+
+    // outline of the glyph last loaded, in font units, and its advance
+    std::vector<FT_Vector> points;
+    std::vector<MyOutlineTag> tags;
+    std::vector<MyOutlineContour> contours;
+    int advance;
+
+    // x of the glyph origin as stored in the glyf table, which is moved to 0
+    long origin;
+
+    MyTrueTypeFont() : data(0), size(0), advance(0), origin(0)
+    {}
+};
+
+// maps a TrueType or OpenType font file and finds its tables, returning
+// false if the file is missing, malformed, or has neither glyf nor CFF
+// outlines
+bool OpenTrueTypeFont(MyTrueTypeFont *font, const std::string &filename);
+
+// unmaps the font file
+void CloseTrueTypeFont(MyTrueTypeFont *font);
+
+// decodes the outline of the glyph with the given index into the font's
+// outline arrays, returning false if the glyph data is malformed
+bool LoadTrueTypeGlyph(MyTrueTypeFont *font, unsigned int glyphIndex);
+
+// a view of the glyph last loaded as a FreeType outline
+FT_Outline TrueTypeOutline(MyTrueTypeFont *font);
+
+// --------------------------------------------------------------------------
+#endif // TRUETYPE_H
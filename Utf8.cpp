@@ -0,0 +1,124 @@
+// ==========================================================================
+// UTF-8 Decoding
+// ==========================================================================
+
+#include "Utf8.h"
+
+#include <cstring>
+#include <stdint.h>
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+
+namespace {
+
+// number of bytes in a sequence with the given lead byte, or 0 if the byte
+// cannot start one
+int SequenceLength(unsigned char lead)
+{
+    if (lead < 0x80) return 1;
+    if (lead < 0xC2) return 0;  // continuation bytes and overlong 2-byte leads
+    if (lead < 0xE0) return 2;
+    if (lead < 0xF0) return 3;
+    if (lead < 0xF5) return 4;
+    return 0;
+}
+
+// whether byte is a valid second byte after the given lead; the tighter
+// ranges after E0, ED, F0 and F4 rule out overlong forms, surrogates and
+// values past U+10FFFF
+bool ValidSecond(unsigned char lead, unsigned char byte)
+{
+    if (lead == 0xE0) return byte >= 0xA0 && byte <= 0xBF;
+    if (lead == 0xED) return byte >= 0x80 && byte <= 0x9F;
+    if (lead == 0xF0) return byte >= 0x90 && byte <= 0xBF;
+    if (lead == 0xF4) return byte >= 0x80 && byte <= 0x8F;
+    return (byte & 0xC0) == 0x80;
+}
+
+} // namespace
+
+// --------------------------------------------------------------------------
+
+int DecodeUtf8(const char *text, int length, int *codepoints)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(text);
+    int count = 0;
+    int i = 0;
+
+    while (i < length)
+    {
+        // ASCII fast path: eight bytes at a time while none has its top bit set
+        while (i + 8 <= length)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i, 8);
+            if (word & 0x8080808080808080ULL) break;
+            for (int k = 0; k < 8; ++k)
+                codepoints[count + k] = bytes[i + k];
+            count += 8;
+            i += 8;
+        }
+        if (i >= length) break;
+
+        unsigned char lead = bytes[i];
+        if (lead < 0x80) {
+            codepoints[count++] = lead;
+            ++i;
+            continue;
+        }
+
+        // take continuation bytes for as long as they are valid, so that a
+        // malformed sequence is replaced by one U+FFFD and the byte that
+        // broke it starts the next sequence
+        int needed = SequenceLength(lead);
+        int taken = 1;
+        int value = lead & (0x7F >> needed);
+        while (needed > 0 && taken < needed && i + taken < length)
+        {
+            unsigned char byte = bytes[i + taken];
+            bool valid = (taken == 1) ? ValidSecond(lead, byte) : (byte & 0xC0) == 0x80;
+            if (!valid) break;
+            value = (value << 6) | (byte & 0x3F);
+            ++taken;
+        }
+
+        codepoints[count++] = (needed > 0 && taken == needed) ? value : REPLACEMENT_CHARACTER;
+        i += taken;
+    }
+
+    return count;
+}
+
+void DecodeUtf8(const string &text, vector<int> &codepoints)
+{
+    // every byte makes at most one code point
+    codepoints.resize(text.size());
+    if (text.empty()) return;
+    codepoints.resize(DecodeUtf8(text.data(), text.size(), &codepoints[0]));
+}
+
+void EncodeUtf8(int codepoint, string &text)
+{
+    if (codepoint < 0 || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+        codepoint = REPLACEMENT_CHARACTER;
+
+    if (codepoint < 0x80) {
+        text += char(codepoint);
+        return;
+    }
+    if (codepoint < 0x800) {
+        text += char(0xC0 | (codepoint >> 6));
+    }
+    else if (codepoint < 0x10000) {
+        text += char(0xE0 | (codepoint >> 12));
+        text += char(0x80 | ((codepoint >> 6) & 0x3F));
+    }
+    else {
+        text += char(0xF0 | (codepoint >> 18));
+        text += char(0x80 | ((codepoint >> 12) & 0x3F));
+        text += char(0x80 | ((codepoint >> 6) & 0x3F));
+    }
+    text += char(0x80 | (codepoint & 0x3F));
+}
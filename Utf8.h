@@ -0,0 +1,34 @@
+// ==========================================================================
+// UTF-8 Decoding
+//  - turns UTF-8 text into the stream of Unicode code points it encodes
+//
+// Runs of ASCII, the common case for most text, are copied eight bytes at a
+// time: a whole 64-bit word is tested for set high bits at once, and only
+// words that contain a multi-byte sequence fall back to the byte-wise
+// decoder. Malformed input (stray continuation bytes, truncated or overlong
+// sequences, surrogates, and values past U+10FFFF) is decoded as U+FFFD, one
+// replacement per maximal ill-formed subpart as Unicode recommends.
+// ==========================================================================
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <string>
+#include <vector>
+
+// code point written in place of each malformed sequence
+const int REPLACEMENT_CHARACTER = 0xFFFD;
+
+// decodes length bytes of text into codepoints, which must have room for at
+// least length entries, and returns the number of code points written
+int DecodeUtf8(const char *text, int length, int *codepoints);
+
+// decodes a string into the given list, replacing its contents but reusing
+// its storage
+void DecodeUtf8(const std::string &text, std::vector<int> &codepoints);
+
+// appends the UTF-8 encoding of a code point to text, or of U+FFFD for a
+// surrogate or a value past U+10FFFF
+void EncodeUtf8(int codepoint, std::string &text);
+
+// --------------------------------------------------------------------------
+#endif // UTF8_H
@@ -16,12 +16,31 @@
 #include <iterator>
 #include <algorithm>
 #include <vector>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <sstream>
+#include <cstring>
+#include <sys/stat.h>
+#include <thread>
 
 // specify that we want the OpenGL core profile before including GLFW headers
 #define GLFW_INCLUDE_GLCOREARB
 #define GL_GLEXT_PROTOTYPES
 #include <GLFW/glfw3.h>
 #include "GlyphExtractor.h"
+#include "LoopBlinn.h"
+#include "InputQueue.h"
+#include "JobSystem.h"
+#include "Arena.h"
+#include "Utf8.h"
+#include "FontStack.h"
+#include "CubicApprox.h"
+#include "Simplify.h"
+#include "SpatialIndex.h"
+#include "OutlineCache.h"
 
 using namespace std;
 
@@ -30,9 +49,41 @@ int version = 1;
 int curveType = 0;
 int font = 1;
 int moreFont = 1;
+int filled = 0;
 float delta = 1;
 float delta2 = 0.05;
+float deltaPrevious = 1;
+float scrollOffset = 1;
 bool hasScrolled = false;
+
+// what has to be redone before the next frame, marked by input and animation
+const unsigned int DIRTY_FRAME = 1;      // the window contents are out of date
+const unsigned int DIRTY_COMMANDS = 2;   // different runs or glyphs are in view
+unsigned int dirty = DIRTY_FRAME | DIRTY_COMMANDS;
+
+// input gathered by the GLFW callbacks for the render thread
+MyInputQueue inputQueue;
+
+// size of the framebuffer in pixels, as last sent to the render thread
+int framebufferWidth = 0;
+int framebufferHeight = 0;
+
+// set this true to measure the time from key presses to the frames showing
+// them, written to latencyPath on exit; each measured frame waits for the
+// GPU to finish, so leave it off otherwise
+#define MEASURE_LATENCY 0
+string latencyPath = "latency.txt";
+
+// set this false to keep the cubic segments of CFF fonts; otherwise each is
+// replaced by quadratics that stray from it by at most cubicTolerance EM
+#define CUBIC_TO_QUADRATIC 1
+float cubicTolerance = 0.001f;
+
+// each glyph outline is also staged simplified to these tolerances, in EM,
+// and drawn at the coarsest level that strays by at most lodPixels pixels
+const int LOD_LEVELS = 3;
+const float lodTolerance[LOD_LEVELS] = { 0, 1.0f / 256, 1.0f / 64 };
+float lodPixels = 0.5f;
 // --------------------------------------------------------------------------
 // OpenGL utility and support function prototypes
 
@@ -44,6 +95,11 @@ string LoadSource(const string &filename);
 GLuint CompileShader(GLenum shaderType, const string &source);
 GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader, GLuint tessControlShader, GLuint tessEvalShader);
 GLuint LinkLineProgram(GLuint vertexShader, GLuint fragmentShader);
+
+string programCachePath = "shadercache/";
+string ProgramCacheKey(const string &sources);
+GLuint LoadProgramBinary(const string &key);
+void SaveProgramBinary(GLuint program, const string &key);
 // --------------------------------------------------------------------------
 // Functions to set up OpenGL shader programs for rendering
 
@@ -56,23 +112,49 @@ struct MyShader
     GLuint tesseval;
     GLuint program;
 
+    // location of the per-draw colour of the control polygon programs,
+    // resolved once the program is linked
+    GLint  colorType;
+
     // initialize shader and program names to zero (OpenGL reserved value)
-    MyShader() : vertex(0), fragment(0), tesscontrol(0), tesseval(0), program(0)
+    MyShader() : vertex(0), fragment(0), tesscontrol(0), tesseval(0), program(0), colorType(-1)
     {}
 };
 
-// load, compile, and link shaders, returning true if successful
-bool InitializeShaders(MyShader *shader)
+// returns shader source with the #define lines selecting one variant inserted
+// straight after its #version line
+string SpecializeSource(const string &source, int scene, int degree)
+{
+    if (source.empty()) return source;
+
+    ostringstream defines;
+    defines << "#define SCENE " << scene << "\n"
+            << "#define DEGREE " << degree << "\n";
+
+    size_t version = source.find("#version");
+    size_t line = (version == string::npos) ? 0 : source.find('\n', version);
+    if (line == string::npos) return source + "\n" + defines.str();
+    return source.substr(0, line + 1) + defines.str() + source.substr(line + 1);
+}
+
+// load, compile, and link shaders specialised for a scene and for curves of
+// one degree, returning true if successful
+bool InitializeShaders(MyShader *shader, int scene, int degree)
 {
     // load shader source from files
-    string vertexSource = LoadSource("vertex.glsl");
-    string fragmentSource = LoadSource("fragment.glsl");
-    string tessellationControlSource = LoadSource("tesscontrol.glsl");
-    string tessellationEvalSource = LoadSource("tesseval.glsl");
+    string vertexSource = SpecializeSource(LoadSource("vertex.glsl"), scene, degree);
+    string fragmentSource = SpecializeSource(LoadSource("fragment.glsl"), scene, degree);
+    string tessellationControlSource = SpecializeSource(LoadSource("tesscontrol.glsl"), scene, degree);
+    string tessellationEvalSource = SpecializeSource(LoadSource("tesseval.glsl"), scene, degree);
     //***load tessel/ation shaders
 
     if (vertexSource.empty() || fragmentSource.empty() || tessellationControlSource.empty() || tessellationEvalSource.empty() ) return false;
 
+    // reuse the program linked by an earlier run when its binary is cached
+    string key = ProgramCacheKey(vertexSource + fragmentSource + tessellationControlSource + tessellationEvalSource);
+    shader->program = LoadProgramBinary(key);
+    if (shader->program) return !CheckGLErrors();
+
     // compile shader source into shader objects
     shader->vertex = CompileShader(GL_VERTEX_SHADER, vertexSource);
     shader->fragment = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
@@ -82,6 +164,7 @@ bool InitializeShaders(MyShader *shader)
 
     // link shader program
     shader->program = LinkProgram(shader->vertex, shader->fragment,shader->tesscontrol, shader->tesseval/*Link tessellation shaders*/);
+    SaveProgramBinary(shader->program, key);
 
     // check for OpenGL errors and return false if error occurred
     return !CheckGLErrors();
@@ -99,19 +182,27 @@ void DestroyShaders(MyShader *shader)
     glDeleteShader(shader->tesseval);
 }
 
-bool InitializeLineShaders(MyShader *shader)
+// load, compile, and link the control polygon shaders specialised for a
+// scene, returning true if successful
+bool InitializeLineShaders(MyShader *shader, int scene)
 {
     // load shader source from files
-    string vertexSource = LoadSource("vertex2.glsl");
-    string fragmentSource = LoadSource("fragment2.glsl");
+    string vertexSource = SpecializeSource(LoadSource("vertex2.glsl"), scene, 0);
+    string fragmentSource = SpecializeSource(LoadSource("fragment2.glsl"), scene, 0);
     if (vertexSource.empty() || fragmentSource.empty()) return false;
 
+    // reuse the program linked by an earlier run when its binary is cached
+    string key = ProgramCacheKey(vertexSource + fragmentSource);
+    shader->program = LoadProgramBinary(key);
+    if (shader->program) return !CheckGLErrors();
+
     // compile shader source into shader objects
     shader->vertex = CompileShader(GL_VERTEX_SHADER, vertexSource);
     shader->fragment = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
 
     // link shader program
     shader->program = LinkLineProgram(shader->vertex, shader->fragment);
+    SaveProgramBinary(shader->program, key);
 
     // check for OpenGL errors and return false if error occurred
     return !CheckGLErrors();
@@ -127,22 +218,246 @@ void DestroyLineShaders(MyShader *shader)
     glDeleteShader(shader->fragment);
 }
 
+// load, compile, and link the glyph fill shaders specialised for a scene,
+// returning true if successful
+bool InitializeFillShaders(MyShader *shader, int scene)
+{
+    // load shader source from files
+    string vertexSource = SpecializeSource(LoadSource("fillvertex.glsl"), scene, 0);
+    string fragmentSource = SpecializeSource(LoadSource("fillfragment.glsl"), scene, 0);
+    if (vertexSource.empty() || fragmentSource.empty()) return false;
+
+    // reuse the program linked by an earlier run when its binary is cached
+    string key = ProgramCacheKey(vertexSource + fragmentSource);
+    shader->program = LoadProgramBinary(key);
+    if (shader->program) return !CheckGLErrors();
+
+    // compile shader source into shader objects
+    shader->vertex = CompileShader(GL_VERTEX_SHADER, vertexSource);
+    shader->fragment = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+
+    // link shader program
+    shader->program = LinkLineProgram(shader->vertex, shader->fragment);
+    SaveProgramBinary(shader->program, key);
+
+    // check for OpenGL errors and return false if error occurred
+    return !CheckGLErrors();
+}
+
+// --------------------------------------------------------------------------
+// Shader variants, each compiled once and looked up by what it is built for
+
+// uniform buffer binding point of the FrameState block in every program
+const GLuint FRAME_STATE_BINDING = 0;
+
+// which set of shader sources a program is built from
+enum MyProgramKind { OUTLINE_PROGRAM, LINE_PROGRAM, FILL_PROGRAM };
+
+struct MyShaderCache
+{
+    // programs keyed by kind, scene and curve degree
+    map<int, MyShader> variants;
+};
+
+int ShaderKey(MyProgramKind kind, int scene, int degree)
+{
+    return (int(kind) * 8 + scene) * 4 + degree;
+}
+
+// returns the program for a variant, compiling it the first time it is asked
+// for; a variant that fails to build is kept with program zero so it is not
+// rebuilt every frame
+MyShader *GetShader(MyShaderCache *cache, MyProgramKind kind, int scene, int degree = 0)
+{
+    int key = ShaderKey(kind, scene, degree);
+    map<int, MyShader>::iterator found = cache->variants.find(key);
+    if (found != cache->variants.end())
+        return &found->second;
+
+    MyShader &shader = cache->variants[key];
+    bool built = false;
+    if (kind == OUTLINE_PROGRAM)
+        built = InitializeShaders(&shader, scene, degree);
+    else if (kind == LINE_PROGRAM)
+        built = InitializeLineShaders(&shader, scene);
+    else
+        built = InitializeFillShaders(&shader, scene);
+
+    if (!built)
+        cout << "ERROR: shader variant for scene " << scene << ", degree "
+             << degree << " failed to build" << endl;
+
+    // look up names once here rather than every time the program is used
+    if (shader.program)
+    {
+        GLuint block = glGetUniformBlockIndex(shader.program, "FrameState");
+        if (block != GL_INVALID_INDEX)
+            glUniformBlockBinding(shader.program, block, FRAME_STATE_BINDING);
+        shader.colorType = glGetUniformLocation(shader.program, "colorType");
+    }
+    return &shader;
+}
+
+// builds every variant the scenes draw with up front, so none is compiled in
+// the middle of a frame, returning true if all were successful
+bool InitializeShaderCache(MyShaderCache *cache)
+{
+    bool built = true;
+    for (int scene = 1; scene <= 4; scene++)
+    {
+        for (int degree = 0; degree <= 3; degree++)
+        {
+            // the first two scenes only hold curves of a single degree
+            if ((scene == 1 && degree != 2) || (scene == 2 && degree != 3))
+                continue;
+            built = GetShader(cache, OUTLINE_PROGRAM, scene, degree)->program && built;
+        }
+        built = GetShader(cache, LINE_PROGRAM, scene)->program && built;
+        if (scene >= 3)
+            built = GetShader(cache, FILL_PROGRAM, scene)->program && built;
+    }
+    return built && !CheckGLErrors();
+}
+
+void DestroyShaderCache(MyShaderCache *cache)
+{
+    for (map<int, MyShader>::iterator it = cache->variants.begin(); it != cache->variants.end(); ++it)
+    {
+        if (it->first / 32 == OUTLINE_PROGRAM)
+            DestroyShaders(&it->second);
+        else
+            DestroyLineShaders(&it->second);
+    }
+    cache->variants.clear();
+}
+
+// --------------------------------------------------------------------------
+// State shared by every program, laid out as the std140 FrameState block
+
+struct MyFrameState
+{
+    GLfloat colour[4];
+    GLfloat offset[2];
+    GLfloat tessLevel;
+    GLfloat padding;
+};
+
+struct MyFrameUniforms
+{
+    // OpenGL name for the uniform buffer, and the state last uploaded to it
+    GLuint       buffer;
+    MyFrameState uploaded;
+    bool         valid;
+
+    // initialize object names to zero (OpenGL reserved value)
+    MyFrameUniforms() : buffer(0), valid(false)
+    {}
+};
+
+// creates the uniform buffer and binds it for every program, returning true
+// if successful
+bool InitializeFrameUniforms(MyFrameUniforms *uniforms)
+{
+    glGenBuffers(1, &uniforms->buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, uniforms->buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(MyFrameState), 0, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_STATE_BINDING, uniforms->buffer);
+
+    // check for OpenGL errors and return false if error occurred
+    return !CheckGLErrors();
+}
+
+// gathers this frame's shared state, uploading it only when it has changed
+void UpdateFrameUniforms(MyFrameUniforms *uniforms)
+{
+    MyFrameState state = { { 1, 0, 0, 1 }, { 0, 0 }, 32, 0 };
+
+    // only the marquee of scene 4 scrolls
+    if (scene == 4)
+        state.offset[0] = scrollOffset;
+
+    if (uniforms->valid && memcmp(&state, &uniforms->uploaded, sizeof(state)) == 0)
+        return;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, uniforms->buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(state), &state);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    uniforms->uploaded = state;
+    uniforms->valid = true;
+}
+
+void DestroyFrameUniforms(MyFrameUniforms *uniforms)
+{
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_STATE_BINDING, 0);
+    glDeleteBuffers(1, &uniforms->buffer);
+}
+
 // --------------------------------------------------------------------------
 // Functions to set up OpenGL buffers for storing geometry data
 
+// Control points are stored as pairs of 16-bit integers in half font units,
+// which is exact for outline points and for the on-curve midpoints between
+// them. The lowest bit of x and of y together hold the degree of the segment
+// the point belongs to, leaving fifteen bits for the coordinate itself.
+struct MyVertex
+{
+    GLshort x, y;
+};
+
+// quantizes a point given in EM units of a face with em font units per EM
+MyVertex PackVertex(float x, float y, float em, int degree)
+{
+    long qx = lround(x * em * 2);
+    long qy = lround(y * em * 2);
+    qx = max(-16384L, min(16383L, qx));
+    qy = max(-16384L, min(16383L, qy));
+
+    MyVertex v;
+    v.x = GLshort(qx * 2 + (degree & 1));
+    v.y = GLshort(qy * 2 + ((degree >> 1) & 1));
+    return v;
+}
+
 struct MyGeometry
 {
     // OpenGL names for array buffer objects, vertex array object
     GLuint  vertexBuffer;
-    GLuint  colourBuffer;
     GLuint  vertexArray;
     GLsizei elementCount;
 
     // initialize object names to zero (OpenGL reserved value)
-    MyGeometry() : vertexBuffer(0), colourBuffer(0), vertexArray(0), elementCount(0)
+    MyGeometry() : vertexBuffer(0), vertexArray(0), elementCount(0)
     {}
 };
 
+// uploads packed control points and sets up the vertex array that reads them
+void UploadVertices(MyGeometry *geometry, const MyVertex *vertices, GLsizei count)
+{
+    // this vertex attribute index corresponds to the one specified for the
+    // input variable in the vertex shaders
+    const GLuint VERTEX_INDEX = 0;
+
+    // create an array buffer object for storing our vertices
+    glGenBuffers(1, &geometry->vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(MyVertex), vertices, GL_STATIC_DRAW);
+
+    // create a vertex array object encapsulating all our vertex attributes
+    glGenVertexArrays(1, &geometry->vertexArray);
+    glBindVertexArray(geometry->vertexArray);
+
+    // associate the packed integer positions with the vertex array object
+    glVertexAttribIPointer(VERTEX_INDEX, 2, GL_SHORT, 0, 0);
+    glEnableVertexAttribArray(VERTEX_INDEX);
+
+    // unbind our buffers, resetting to default state
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    geometry->elementCount = count;
+}
+
 // create buffers and fill with geometry data, returning true if successful
 bool InitializeGeometry(MyGeometry *geometry)
 {
@@ -153,19 +468,15 @@ bool InitializeGeometry(MyGeometry *geometry)
 		{ 1.0/2.5,  1.0/2.5},
 		{ 2.0/2.5, -1.0/2.5},
 		{ 0.0/2.5, -1.0/2.5},
-		{ 0, 0 },//d
 		{ 0.0/2.5, -1.0/2.5},
 		{ -2.0/2.5,-1.0/2.5},
 		{ -1.0/2.5, 1.0/2.5},
-		{ 0, 0 },//d
 		{ -1.0/2.5, 1.0/2.5},
 		{ 0.0/2.5, 1.0/2.5 },
 		{ 1.0/2.5, 1.0/2.5 },
-		{ 0, 0 },//d
 		{ 1.2/2.5, 0.5/2.5 },
 		{ 2.5/2.5, 1.0/2.5},
 		{ 1.3/2.5, -0.4/2.5},
-		{ 0, 0 },//d
 		//cubic
 		{ 1.0/9.0, 1.0/9.0 },
 		{ 4.0/9.0, 0.0/9.0 },
@@ -189,261 +500,1190 @@ bool InitializeGeometry(MyGeometry *geometry)
 		{ 2.8/9.0, 3.5/9.0 }
 		};    
 
-    GLfloat curveColours[][3] = {
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },        
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },        
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },        
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },
-        { 1.0, 0.0, 0.0 },             
-        { 1.0, 0.0, 0.0 },             
-        { 1.0, 0.0, 0.0 }        
-    };
-
-    geometry->elementCount = 20;
+    // the quadratics lie on a grid of 1/25 and the cubics on a grid of 1/90,
+    // so both are stored exactly when treated as faces of that many units
+    MyVertex packed[32];
+    for (int i = 0; i < 12; i++)
+        packed[i] = PackVertex(vertices[i][0], vertices[i][1], 25, 2);
+    for (int i = 12; i < 32; i++)
+        packed[i] = PackVertex(vertices[i][0], vertices[i][1], 90, 3);
 
-    // these vertex attribute indices correspond to those specified for the
-    // input variables in the vertex shader
-    const GLuint VERTEX_INDEX = 0;
-    const GLuint COLOUR_INDEX = 1;
+    UploadVertices(geometry, packed, 32);
 
-    // create an array buffer object for storing our vertices
-    glGenBuffers(1, &geometry->vertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    // check for OpenGL errors and return false if error occurred
+    return !CheckGLErrors();
+}
 
-    // create another one for storing our colours
-    glGenBuffers(1, &geometry->colourBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->colourBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(curveColours), curveColours, GL_STATIC_DRAW);
-    
-    // create a vertex array object encapsulating all our vertex attributes
-    glGenVertexArrays(1, &geometry->vertexArray);
-    glBindVertexArray(geometry->vertexArray);
+// deallocate geometry-related objects
+void DestroyGeometry(MyGeometry *geometry)
+{
+    // unbind and destroy our vertex array object and associated buffers
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &geometry->vertexArray);
+    glDeleteBuffers(1, &geometry->vertexBuffer);
+}
 
-    // associate the position array with the vertex array object
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
-    glVertexAttribPointer(VERTEX_INDEX, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(VERTEX_INDEX);
+// --------------------------------------------------------------------------
+// Shared glyph outline storage. Each distinct glyph is packed into the shared
+// buffers once; strings of text draw it as instances placed by pen position.
+
+// the control points of one level of detail of a glyph outline, with the
+// segments ordered by degree and the number of points of each
+struct MyOutlineLevel
+{
+    GLint   first;
+    GLsizei degreeCount[4];
+};
+
+// where one glyph's data lives in the shared buffers
+struct MyOutline
+{
+    // control points of the full outline in the outline buffer, degree + 1
+    // per segment, followed by those of each simplified level
+    GLint   first;
+    GLsizei count;
+    MyOutlineLevel levels[LOD_LEVELS];
+
+    // stencil triangles in the fill buffer, followed by a six vertex cover quad
+    GLint   fillFirst;
+    GLsizei fillCount;
+
+    // advance width to the next glyph and tight bounds, in EM units
+    float   advance;
+    MyBounds bounds;
+};
+
+// one glyph occurrence: its pen position and the EM scale of its face
+struct MyInstance
+{
+    GLfloat x, y;
+    GLfloat emScale;
+};
+
+// a glyph of a face, by the character it was asked for
+typedef pair<const GlyphExtractor *, int> MyGlyphKey;
+
+struct MyGlyphKeyHash
+{
+    size_t operator()(const MyGlyphKey &key) const
+    {
+        return hash<const void *>()(key.first) * 31 + key.second;
+    }
+};
+
+typedef unordered_map<MyGlyphKey, int, MyGlyphKeyHash, equal_to<MyGlyphKey>,
+                      MyArenaAllocator<pair<const MyGlyphKey, int> > > MyGlyphLookup;
+
+struct MyOutlineStore
+{
+    // OpenGL names for the shared outline, fill and instance buffers, and
+    // the vertex arrays reading outlines and fill triangles with instances
+    GLuint  vertexBuffer;
+    GLuint  fillBuffer;
+    GLuint  instanceBuffer;
+    GLuint  vertexArray;
+    GLuint  fillArray;
+
+    // staged data, released once uploaded
+    vector<MyVertex>     vertices;
+    vector<MyFillVertex> triangles;
+    vector<MyInstance>   instances;
+
+    // outlines, and the index of each (face, character) already added;
+    // entries are never removed, so the lookup draws from an arena of its own
+    vector<MyOutline> outlines;
+    MyArena       lookupArena;
+    MyGlyphLookup lookup;
+
+    // initialize object names to zero (OpenGL reserved value)
+    MyOutlineStore()
+        : vertexBuffer(0), fillBuffer(0), instanceBuffer(0), vertexArray(0), fillArray(0),
+          lookupArena(64 * 1024),
+          lookup(0, MyGlyphKeyHash(), equal_to<MyGlyphKey>(),
+                 MyArenaAllocator<pair<const MyGlyphKey, int> >(&lookupArena))
+    {}
+};
+
+// appends a quad covering the triangles from index first onwards
+void AddCoverQuad(ArenaVector<MyFillVertex> &triangles, size_t first)
+{
+	float xMin = 0, xMax = 0, yMin = 0, yMax = 0;
+	for(size_t i = first; i < triangles.size(); i++)
+	{
+		if(i == first || triangles[i].x < xMin) xMin = triangles[i].x;
+		if(i == first || triangles[i].x > xMax) xMax = triangles[i].x;
+		if(i == first || triangles[i].y < yMin) yMin = triangles[i].y;
+		if(i == first || triangles[i].y > yMax) yMax = triangles[i].y;
+	}
+
+	float cover[6][2] = {
+		{ xMin, yMin }, { xMax, yMin }, { xMax, yMax },
+		{ xMin, yMin }, { xMax, yMax }, { xMin, yMax }
+	};
+	for(int i = 0; i < 6; i++)
+	{
+		MyFillVertex v = { cover[i][0], cover[i][1], 0, 0, 0, 0 };
+		triangles.push_back(v);
+	}
+}
+
+// a glyph outline packed and triangulated on its own, ready to be appended to
+// the shared store
+struct MyPreparedOutline
+{
+    // the segments of every contour back to back, and the index one past the
+    // last segment of each contour
+    ArenaVector<MySegment> segments;
+    ArenaVector<int> contourEnds;
+    float advance;
+
+    // control points of each level of detail in turn, grouped by degree,
+    // and the number of each degree in each level
+    ArenaVector<MyVertex> vertices;
+    GLsizei degreeCount[LOD_LEVELS][4];
+
+    // stencil triangles followed by the cover quad
+    ArenaVector<MyFillVertex> triangles;
+    GLsizei fillCount;
+
+    // tight bounds of the outline as extracted, in EM units
+    MyBounds bounds;
+
+    // the packed data is drawn from the given arena, or the heap if none
+    MyPreparedOutline(MyArena *arena = 0)
+        : segments(MyArenaAllocator<MySegment>(arena)), contourEnds(MyArenaAllocator<int>(arena)),
+          advance(0), vertices(MyArenaAllocator<MyVertex>(arena)), triangles(MyArenaAllocator<MyFillVertex>(arena))
+    {}
+};
 
-    // assocaite the colour array with the vertex array object
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->colourBuffer);
-    glVertexAttribPointer(COLOUR_INDEX, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(COLOUR_INDEX);
+// extracts the outline of a character straight into the prepared outline's
+// own buffers, growing them and trying again only if the glyph does not fit
+void ExtractOutline(MyPreparedOutline *prepared, const GlyphExtractor *face, int character)
+{
+	if(prepared->segments.size() < 64) prepared->segments.resize(64);
+	if(prepared->contourEnds.size() < 8) prepared->contourEnds.resize(8);
+
+	int contours = 0;
+	int count = face->ExtractSegments(character, &prepared->segments[0], prepared->segments.size(),
+	                                  &prepared->contourEnds[0], prepared->contourEnds.size(),
+	                                  &contours, &prepared->advance);
+	if(count > int(prepared->segments.size()) || contours > int(prepared->contourEnds.size()))
+	{
+		prepared->segments.resize(max(count, 1));
+		prepared->contourEnds.resize(max(contours, 1));
+		count = face->ExtractSegments(character, &prepared->segments[0], prepared->segments.size(),
+		                              &prepared->contourEnds[0], prepared->contourEnds.size(),
+		                              &contours, &prepared->advance);
+	}
+	prepared->segments.resize(count);
+	prepared->contourEnds.resize(contours);
+	prepared->bounds = OutlineBounds(prepared->segments.data(), count);
+}
+
+// holds the temporary data of one batch of glyph staging or one layout at a
+// time
+MyArena layoutArena;
+
+// holds the scratch data of one frame, and is reset as each frame begins
+MyArena frameArena(64 * 1024);
+
+// replaces every cubic segment of a prepared outline by quadratics, which
+// are drawn by the cheaper quadratic program and filled without splitting
+void ConvertCubics(MyPreparedOutline *prepared)
+{
+	ArenaVector<MySegment> segments(prepared->segments.get_allocator());
+	ArenaVector<int> contourEnds(prepared->contourEnds.get_allocator());
+	segments.reserve(prepared->segments.size());
+	contourEnds.reserve(prepared->contourEnds.size());
+
+	uint k = 0;
+	for(uint c = 0; c < prepared->contourEnds.size(); c++)
+	{
+		for(; k < uint(prepared->contourEnds[c]); k++)
+		{
+			const MySegment &segment = prepared->segments[k];
+			if(segment.degree != 3)
+			{
+				segments.push_back(segment);
+				continue;
+			}
+			MySegment quadratics[MAX_QUADRATICS];
+			int count = ApproximateCubic(segment, cubicTolerance, quadratics);
+			segments.insert(segments.end(), quadratics, quadratics + count);
+		}
+		contourEnds.push_back(segments.size());
+	}
+
+	prepared->segments.swap(segments);
+	prepared->contourEnds.swap(contourEnds);
+}
+
+// packs and triangulates an extracted glyph of a face with em units per EM;
+// touches nothing shared, so any number may run at once
+void PrepareOutline(MyPreparedOutline *prepared, float em)
+{
+	if(CUBIC_TO_QUADRATIC)
+		ConvertCubics(prepared);
+
+	// segments of each degree are kept together so that each degree can be
+	// drawn by its own specialised program
+	MyArenaAllocator<MyVertex> scratch(prepared->vertices.get_allocator());
+	ArenaVector<MyVertex> byDegree[4] = {
+		ArenaVector<MyVertex>(scratch), ArenaVector<MyVertex>(scratch),
+		ArenaVector<MyVertex>(scratch), ArenaVector<MyVertex>(scratch)
+	};
+
+	// every level after the full outline is a simplified copy of it
+	ArenaVector<MySegment> simplified(prepared->segments.size(), MySegment(),
+	                                  prepared->segments.get_allocator());
+	ArenaVector<int> simplifiedEnds(prepared->contourEnds.size(), 0,
+	                                prepared->contourEnds.get_allocator());
+
+	prepared->vertices.clear();
+	for(int level = 0; level < LOD_LEVELS; level++)
+	{
+		const MySegment *segments = prepared->segments.data();
+		int count = prepared->segments.size();
+		if(level > 0 && count > 0)
+		{
+			count = SimplifyOutline(prepared->segments.data(), prepared->contourEnds.data(),
+			                        prepared->contourEnds.size(), lodTolerance[level],
+			                        simplified.data(), simplifiedEnds.data());
+			segments = simplified.data();
+		}
+
+		//Get kth Segment of the glyph's contours, one patch of degree + 1 vertices
+		for(int k = 0; k < count; k++)
+		{
+			const MySegment &segment = segments[k];
+			int degree = min(segment.degree, 3u);
+
+			for(int v = 0; v <= degree; v++)
+				byDegree[degree].push_back(PackVertex(segment.x[v], segment.y[v], em, degree));
+		}
+		for(int d = 0; d < 4; d++)
+		{
+			prepared->degreeCount[level][d] = byDegree[d].size();
+			prepared->vertices.insert(prepared->vertices.end(), byDegree[d].begin(), byDegree[d].end());
+			byDegree[d].clear();
+		}
+	}
+
+	// stencil triangles for the fill, then a quad covering them
+	prepared->triangles.clear();
+	TriangulateGlyph(prepared->segments.data(), prepared->contourEnds.data(),
+	                 prepared->contourEnds.size(), 0, prepared->triangles);
+	prepared->fillCount = prepared->triangles.size();
+	AddCoverQuad(prepared->triangles, 0);
+}
+
+// appends a prepared outline to the store under the given key, returning
+// its index
+int CommitOutline(MyOutlineStore *store, const MyGlyphKey &key,
+                  const MyPreparedOutline &prepared)
+{
+	MyOutline outline;
+	outline.first = store->vertices.size();
+	outline.count = 0;
+	GLint first = outline.first;
+	for(int level = 0; level < LOD_LEVELS; level++)
+	{
+		outline.levels[level].first = first;
+		for(int d = 0; d < 4; d++)
+		{
+			outline.levels[level].degreeCount[d] = prepared.degreeCount[level][d];
+			first += prepared.degreeCount[level][d];
+			if(level == 0)
+				outline.count += prepared.degreeCount[level][d];
+		}
+	}
+	outline.fillFirst = store->triangles.size();
+	outline.fillCount = prepared.fillCount;
+	outline.advance = prepared.advance;
+	outline.bounds = prepared.bounds;
+
+	store->vertices.insert(store->vertices.end(), prepared.vertices.begin(), prepared.vertices.end());
+	store->triangles.insert(store->triangles.end(), prepared.triangles.begin(), prepared.triangles.end());
+
+	int index = store->outlines.size();
+	store->outlines.push_back(outline);
+	store->lookup[key] = index;
+	return index;
+}
+
+// returns the index of the outline for a character, extracting and staging
+// it the first time it is asked for; the staging is done in the layout
+// arena, which the caller resets
+int AddOutline(MyOutlineStore *store, GlyphExtractor *face, int character)
+{
+	MyGlyphKey key(face, character);
+	MyGlyphLookup::iterator found = store->lookup.find(key);
+	if(found != store->lookup.end())
+		return found->second;
+
+	MyPreparedOutline prepared(&layoutArena);
+	ExtractOutline(&prepared, face, character);
+	PrepareOutline(&prepared, face->UnitsPerEM());
+	return CommitOutline(store, key, prepared);
+}
+
+// stages every glyph the given code point strings need that the store does
+// not hold yet, spreading the work over the job system: each face extracts
+// its own glyphs in one job, since a FreeType face cannot be used by two
+// threads at once, and the packing and triangulation of every glyph is split
+// over all cores
+void AddOutlines(MyOutlineStore *store, MyFontStack **stacks, const vector<int> **texts, int count)
+{
+	// everything but the store's own buffers lives in the layout arena, so a
+	// batch costs no heap allocations once the arena has grown to fit
+	MyArena *arena = &layoutArena;
+	ArenaVector<MyGlyphKey> keys((MyArenaAllocator<int>(arena)));
+	ArenaVector<GlyphExtractor *> keyFaces((MyArenaAllocator<int>(arena)));
+	unordered_set<MyGlyphKey, MyGlyphKeyHash, equal_to<MyGlyphKey>, MyArenaAllocator<MyGlyphKey> >
+		seen(0, MyGlyphKeyHash(), equal_to<MyGlyphKey>(), MyArenaAllocator<MyGlyphKey>(arena));
+	for(int r = 0; r < count; r++)
+	{
+		for(uint i = 0; i < texts[r]->size(); i++)
+		{
+			int character = (*texts[r])[i];
+			GlyphExtractor *face = ResolveFace(stacks[r], character);
+			MyGlyphKey key(face, character);
+			if(store->lookup.count(key) || !seen.insert(key).second)
+				continue;
+			keys.push_back(key);
+			keyFaces.push_back(face);
+		}
+	}
+
+	ArenaVector<GlyphExtractor *> distinct((MyArenaAllocator<int>(arena)));
+	for(uint i = 0; i < keyFaces.size(); i++)
+		if(find(distinct.begin(), distinct.end(), keyFaces[i]) == distinct.end())
+			distinct.push_back(keyFaces[i]);
+
+	ArenaVector<MyPreparedOutline> prepared(keys.size(), MyPreparedOutline(arena),
+	                                        MyArenaAllocator<MyPreparedOutline>(arena));
+	ParallelFor(0, distinct.size(), 1, [&](int first, int last) {
+		for(int f = first; f < last; f++)
+			for(uint i = 0; i < keys.size(); i++)
+				if(keyFaces[i] == distinct[f])
+					ExtractOutline(&prepared[i], distinct[f], keys[i].second);
+	});
+	ParallelFor(0, keys.size(), 8, [&](int first, int last) {
+		for(int i = first; i < last; i++)
+			PrepareOutline(&prepared[i], keyFaces[i]->UnitsPerEM());
+	});
+
+	// appended in a fixed order so the buffers are the same on every run
+	for(uint i = 0; i < keys.size(); i++)
+		CommitOutline(store, keys[i], prepared[i]);
+
+	// the arena only hands its memory out again once nothing refers to it
+	prepared.clear();
+	keys.clear();
+	keyFaces.clear();
+	seen.clear();
+	distinct.clear();
+	ResetArena(arena);
+}
+
+// uploads the staged outlines, fill triangles and instances of every laid
+// out run, and sets up the vertex arrays over them, returning true if successful
+bool InitializeOutlineStore(MyOutlineStore *store)
+{
+    // these vertex attribute indices correspond to those specified for the
+    // input variables in the outline and fill vertex shaders
+    const GLuint VERTEX_INDEX = 0;
+    const GLuint INSTANCE_INDEX = 1;
+    const GLuint CURVE_INDEX = 1;
+    const GLuint FILL_INSTANCE_INDEX = 2;
+
+    glGenBuffers(1, &store->vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, store->vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, store->vertices.size() * sizeof(MyVertex),
+                 store->vertices.empty() ? 0 : &store->vertices[0], GL_STATIC_DRAW);
+
+    glGenBuffers(1, &store->fillBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, store->fillBuffer);
+    glBufferData(GL_ARRAY_BUFFER, store->triangles.size() * sizeof(MyFillVertex),
+                 store->triangles.empty() ? 0 : &store->triangles[0], GL_STATIC_DRAW);
+
+    glGenBuffers(1, &store->instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, store->instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, store->instances.size() * sizeof(MyInstance),
+                 store->instances.empty() ? 0 : &store->instances[0], GL_STATIC_DRAW);
+
+    // packed control points, with a pen position and EM scale per instance
+    glGenVertexArrays(1, &store->vertexArray);
+    glBindVertexArray(store->vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, store->vertexBuffer);
+    glVertexAttribIPointer(VERTEX_INDEX, 2, GL_SHORT, 0, 0);
+    glEnableVertexAttribArray(VERTEX_INDEX);
+    glBindBuffer(GL_ARRAY_BUFFER, store->instanceBuffer);
+    glVertexAttribPointer(INSTANCE_INDEX, 3, GL_FLOAT, GL_FALSE, sizeof(MyInstance), 0);
+    glVertexAttribDivisor(INSTANCE_INDEX, 1);
+    glEnableVertexAttribArray(INSTANCE_INDEX);
+
+    // interleaved fill triangles, with a pen position per instance
+    glGenVertexArrays(1, &store->fillArray);
+    glBindVertexArray(store->fillArray);
+    glBindBuffer(GL_ARRAY_BUFFER, store->fillBuffer);
+    glVertexAttribPointer(VERTEX_INDEX, 2, GL_FLOAT, GL_FALSE, sizeof(MyFillVertex), 0);
+    glEnableVertexAttribArray(VERTEX_INDEX);
+    glVertexAttribPointer(CURVE_INDEX, 4, GL_FLOAT, GL_FALSE, sizeof(MyFillVertex),
+                          reinterpret_cast<void *>(2 * sizeof(float)));
+    glEnableVertexAttribArray(CURVE_INDEX);
+    glBindBuffer(GL_ARRAY_BUFFER, store->instanceBuffer);
+    glVertexAttribPointer(FILL_INSTANCE_INDEX, 2, GL_FLOAT, GL_FALSE, sizeof(MyInstance), 0);
+    glVertexAttribDivisor(FILL_INSTANCE_INDEX, 1);
+    glEnableVertexAttribArray(FILL_INSTANCE_INDEX);
 
     // unbind our buffers, resetting to default state
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-	glPatchParameteri(GL_PATCH_VERTICES, 4);
+    // the staged copies are no longer needed once the GPU has them
+    vector<MyVertex>().swap(store->vertices);
+    vector<MyFillVertex>().swap(store->triangles);
+    vector<MyInstance>().swap(store->instances);
 
     // check for OpenGL errors and return false if error occurred
     return !CheckGLErrors();
 }
 
-bool InitializeGlyphGeometry(MyGeometry *geometry, vector<MyGlyph> &fNameGlyphs)
-{					
-	int u = 0; //current vertex index
-	float advance = 0;
-	
-	GLfloat vertices[50000][2];
-	GLfloat curveColours[50000][3]; //initialize colours 2d array
-	
- 
-	for(uint i = 0; i < fNameGlyphs.size(); i++)
+// points the instance attribute of the bound vertex array at the given first
+// instance, for drawing where base instances are unavailable (OpenGL 4.1)
+void SelectInstances(MyOutlineStore *store, GLuint index, GLint firstInstance)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, store->instanceBuffer);
+    glVertexAttribPointer(index, (index == 1) ? 3 : 2, GL_FLOAT, GL_FALSE, sizeof(MyInstance),
+                          reinterpret_cast<void *>(firstInstance * sizeof(MyInstance)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void DestroyOutlineStore(MyOutlineStore *store)
+{
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &store->vertexArray);
+    glDeleteVertexArrays(1, &store->fillArray);
+    glDeleteBuffers(1, &store->vertexBuffer);
+    glDeleteBuffers(1, &store->fillBuffer);
+    glDeleteBuffers(1, &store->instanceBuffer);
+}
+
+// --------------------------------------------------------------------------
+// Animation clock: animations advance in fixed steps of elapsed time, and
+// frames show them interpolated between the last two steps
+
+// length of one animation step, in seconds
+const double ANIMATION_STEP = 1.0 / 120.0;
+
+struct MyAnimationClock
+{
+    // time of the last animated frame, elapsed time not yet stepped, and
+    // whether the last frame was animated
+    double previous;
+    double accumulator;
+    bool   running;
+
+    // display refresh period, and the frames shown and missed while animating
+    double period;
+    long   frames;
+    long   dropped;
+
+    MyAnimationClock() : previous(0), accumulator(0), running(false), period(1.0 / 60), frames(0), dropped(0)
+    {}
+};
+
+// returns how many steps are due since the last animated frame, and through
+// alpha how far time has moved on towards the step after them
+int TickClock(MyAnimationClock *clock, double *alpha)
+{
+	double now = glfwGetTime();
+
+	// an animation starting afresh does not catch up on the time it was idle
+	if(!clock->running)
+	{
+		clock->previous = now;
+		clock->accumulator = 0;
+		clock->running = true;
+	}
+	else
 	{
+		// swaps wait for vertical sync, so a frame that took more than a
+		// refresh period means the display showed the previous one again
+		double elapsed = now - clock->previous;
+		clock->frames++;
+		if(elapsed > 1.5 * clock->period)
+			clock->dropped += long(elapsed / clock->period + 0.5) - 1;
+
+		// after a long stall, skip ahead instead of running every step
+		clock->previous = now;
+		clock->accumulator += min(elapsed, 0.25);
+	}
+
+	int steps = int(clock->accumulator / ANIMATION_STEP);
+	clock->accumulator -= steps * ANIMATION_STEP;
+	*alpha = clock->accumulator / ANIMATION_STEP;
+	return steps;
+}
+
+// called on frames with nothing animating
+void StopClock(MyAnimationClock *clock)
+{
+	clock->running = false;
+}
 
-		//Get jth Contour
-		for(uint j = 0; j < fNameGlyphs[i].contours.size(); j++)
+// --------------------------------------------------------------------------
+// Text runs: a string set in one face, drawn as instances of shared outlines
+
+// every occurrence of one glyph in a run, drawn as a single instanced draw
+struct MyGlyphBatch
+{
+    int     outline;
+    GLint   firstInstance;
+    GLsizei instanceCount;
+};
+
+// where the instance of one glyph of a run went: its batch, its index in the
+// store's instance list, and its pen position in EM units
+struct MyGlyphSlot
+{
+    int   batch;
+    GLint instance;
+    float penX;
+};
+
+struct MyTextRun
+{
+    vector<MyGlyphBatch> batches;
+
+    // the code points laid out, the stack they were set in, and the slot
+    // of each that is drawn
+    const vector<int> *text;
+    MyFontStack *stack;
+    vector<MyGlyphSlot> slots;
+
+    // tight bounds of every glyph drawn, in EM units from the run's origin,
+    // as a whole and indexed by position in the text
+    MyBounds bounds;
+    MySpatialIndex index;
+
+    MyTextRun() : text(0), stack(0)
+    {}
+};
+
+// one glyph drawn by a run while its batches are formed: its outline, its
+// position in the text and its instance
+struct MyPlacement
+{
+	int        outline;
+	int        position;
+	MyInstance instance;
+};
+
+// orders placements by outline, and repeats of one outline by position
+bool PlacedBefore(const MyPlacement &a, const MyPlacement &b)
+{
+	return (a.outline != b.outline) ? a.outline < b.outline : a.position < b.position;
+}
+
+// lays out a string of code points in the given font stack, adding its
+// glyphs and instances to the store and grouping the pen positions of
+// repeated glyphs into one batch each; the box of every glyph drawn is filed
+// in the run's spatial index under its position in the text
+void LayoutTextRun(MyTextRun *run, MyOutlineStore *store, MyFontStack *stack, const vector<int> &text)
+{
+	// the glyphs drawn are gathered in the layout arena and sorted by
+	// outline, which brings the repeats of each glyph together
+	MyArena *arena = &layoutArena;
+	ArenaVector<MyPlacement> placed((MyArenaAllocator<MyPlacement>(arena)));
+	placed.reserve(text.size());
+	float advance = 0;
+
+	run->text = &text;
+	run->stack = stack;
+	run->slots.assign(text.size(), MyGlyphSlot());
+	ClearIndex(&run->index);
+
+	for(uint i = 0; i < text.size(); i++)
+	{
+		// each glyph is scaled by its own face, so fallback glyphs match
+		// the size of the primary face
+		GlyphExtractor *face = ResolveFace(stack, text[i]);
+		float emScale = 0.5f / face->UnitsPerEM();
+		int index = AddOutline(store, face, text[i]);
+		const MyOutline &outline = store->outlines[index];
+
+		// glyphs without contours, like spaces, only move the pen
+		if(outline.count > 0)
 		{
-					
-			//Get kth Segment from jth contour
-			for(uint k = 0; k < fNameGlyphs[i].contours[j].size(); k++)
-			{	
-				int segDegree = fNameGlyphs[i].contours[j][k].degree;
+			MyPlacement placement = { index, int(i), { advance, 0, emScale } };
+			placed.push_back(placement);
+			run->slots[i].penX = advance;
+
+			MyBounds box = outline.bounds;
+			box.xMin += advance;
+			box.xMax += advance;
+			GrowBounds(run->bounds, box.xMin, box.yMin);
+			GrowBounds(run->bounds, box.xMax, box.yMax);
+			InsertBox(&run->index, i, box);
+		}
+		advance += outline.advance;
+	}
 
-				if(segDegree == 0)
-				{
-					vertices[u][0] = fNameGlyphs[i].contours[j][k].x[0]+advance;
-					vertices[u][1] = fNameGlyphs[i].contours[j][k].y[0];
-					vertices[u+1][0] = 0;
-					vertices[u+1][1] = 0;
-					vertices[u+2][0] = 0;	//pad
-					vertices[u+2][1] = 0;
-					vertices[u+3][0] = 0;
-					vertices[u+3][1] = 0;
-				}
-				
-				if(segDegree == 1)
-				{
-					vertices[u][0] = fNameGlyphs[i].contours[j][k].x[0]+advance;
-					vertices[u][1] = fNameGlyphs[i].contours[j][k].y[0];
-					vertices[u+1][0] = fNameGlyphs[i].contours[j][k].x[1]+advance;
-					vertices[u+1][1] = fNameGlyphs[i].contours[j][k].y[1];
-					vertices[u+2][0] = 0;
-					vertices[u+2][1] = 0;	//pad
-					vertices[u+3][0] = 0;
-					vertices[u+3][1] = 0;
-				}
-				
-				if(segDegree == 2)
-				{
-					vertices[u][0] = fNameGlyphs[i].contours[j][k].x[0]+advance;
-					vertices[u][1] = fNameGlyphs[i].contours[j][k].y[0];
-					vertices[u+1][0] = fNameGlyphs[i].contours[j][k].x[1]+advance;
-					vertices[u+1][1] = fNameGlyphs[i].contours[j][k].y[1];
-					vertices[u+2][0] = fNameGlyphs[i].contours[j][k].x[2]+advance;
-					vertices[u+2][1] = fNameGlyphs[i].contours[j][k].y[2];
-					vertices[u+3][0] = 0;
-					vertices[u+3][1] = 0;	//pad
-				}
-				
-				if(segDegree == 3)
-				{
-					vertices[u][0] = fNameGlyphs[i].contours[j][k].x[0]+advance;
-					vertices[u][1] = fNameGlyphs[i].contours[j][k].y[0];
-					vertices[u+1][0] = fNameGlyphs[i].contours[j][k].x[1]+advance;
-					vertices[u+1][1] = fNameGlyphs[i].contours[j][k].y[1];
-					vertices[u+2][0] = fNameGlyphs[i].contours[j][k].x[2]+advance;
-					vertices[u+2][1] = fNameGlyphs[i].contours[j][k].y[2];
-					vertices[u+3][0] = fNameGlyphs[i].contours[j][k].x[3]+advance;
-					vertices[u+3][1] = fNameGlyphs[i].contours[j][k].y[3];
-				}
-				
-				u = u + 4;
-				
-			}
-			
+	sort(placed.begin(), placed.end(), PlacedBefore);
+	for(uint i = 0; i < placed.size(); )
+	{
+		MyGlyphBatch batch;
+		batch.outline = placed[i].outline;
+		batch.firstInstance = store->instances.size();
+
+		uint j = i;
+		for(; j < placed.size() && placed[j].outline == batch.outline; j++)
+		{
+			run->slots[placed[j].position].batch = run->batches.size();
+			run->slots[placed[j].position].instance = store->instances.size();
+			store->instances.push_back(placed[j].instance);
 		}
-		advance += fNameGlyphs[i].advance;
+		batch.instanceCount = j - i;
+		run->batches.push_back(batch);
+		i = j;
 	}
-	
-	//Get ith Glyph
 
-	
-	for(int i = 0; i < u; i++)
+	// the arena only hands its memory out again once nothing refers to it
+	placed.clear();
+	ResetArena(arena);
+}
+
+// scroll speed is given in EM units per sixtieth of a second, the frame rate
+// it was first tuned at
+const float SCROLL_RATE = 60;
+
+// scale from laid out EM units to the view in a scene, matching scaMatrix in
+// vertex.glsl; the view spans -1 to 1 in both directions
+float SceneScale(int scene)
+{
+	return (scene == 2) ? 1.4f : (scene == 3) ? 0.55f : 0.9f;
+}
+
+// maps a point of the view to the EM units of a run drawn in the current
+// scene, undoing traMatrix and scaMatrix in vertex.glsl and the scroll offset
+void ViewToRun(float x, float y, float *runX, float *runY)
+{
+	float shiftX = (scene == 2) ? -0.7f : (scene == 3) ? -0.8f : 0;
+	float shiftY = (scene == 2) ? -0.3f : 0;
+	float offset = (scene == 4) ? scrollOffset : 0;
+
+	*runX = (x - shiftX) / SceneScale(scene) - offset;
+	*runY = (y - shiftY) / SceneScale(scene);
+}
+
+// the part of a run's EM space that is in view in the current scene
+MyBounds RunView()
+{
+	MyBounds view;
+	ViewToRun(-1, -1, &view.xMin, &view.yMin);
+	ViewToRun(1, 1, &view.xMax, &view.yMax);
+	return view;
+}
+
+// advances the scene 4 marquee to the current time, wrapping once the string
+// has scrolled off, and sets the offset to draw it at this frame
+void UpdateScroll(MyTextRun *run, MyAnimationClock *clock)
+{
+	// the marquee moves every frame for as long as it is shown
+	dirty |= DIRTY_FRAME;
+
+	// edge of the view in the run's units
+	float edge = 1 / SceneScale(4);
+
+	if(!clock->running)
+		deltaPrevious = delta;
+
+	double alpha;
+	int steps = TickClock(clock, &alpha);
+	for(int i = 0; i < steps; i++)
 	{
-		curveColours[i][0] = 1;
-		curveColours[i][1] = 0;
-		curveColours[i][2] = 0;
+		float x = run->bounds.xMax + delta;
+		deltaPrevious = delta;
+		delta = delta - delta2 * SCROLL_RATE * ANIMATION_STEP;
+
+		// once the right end of the string has passed the left edge, restart
+		// with its left end at the right edge, without sliding back across
+		if (x < -edge)
+			delta = deltaPrevious = edge - run->bounds.xMin;
 	}
+
+	scrollOffset = deltaPrevious + (delta - deltaPrevious) * alpha;
+}
+
+// --------------------------------------------------------------------------
+// Picking glyphs with the mouse
+
+// a drag in progress: where the left button went down, in view coordinates
+// and in the EM units of the run under it at the time
+struct MySelection
+{
+    bool  dragging;
+    float viewX, viewY;
+    float x, y;
+
+    MySelection() : dragging(false), viewX(0), viewY(0), x(0), y(0)
+    {}
+};
+
+// how far, in view coordinates, the cursor may move between press and
+// release for the two to count as a click rather than a drag
+const float CLICK_SLOP = 0.01f;
+
+// whether a point of a run, in its EM units, is on the ink of one of its
+// glyphs rather than only inside its box, tested on the glyph's outline
+// flattened for the size it is drawn at; the flattened outline is cached, so
+// picking the same glyph again does no curve math
+bool OnGlyphInk(MyFlatCache *cache, const MyTextRun *run, int glyph, float x, float y,
+                float emPixels, float cursorX)
+{
+	int character = (*run->text)[glyph];
+	const GlyphExtractor *face = ResolveFace(run->stack, character);
+
+	// the cursor is this many pixels right of the glyph's origin, which puts
+	// the origin the rest of the way from the left of the window
+	float localX = (x - run->slots[glyph].penX) * emPixels;
+	float originX = cursorX - localX;
+
+	MyFlatKey key = FlatKey(face, face->GlyphIndex(character), emPixels, originX);
+	const MyFlatOutline *flat = FindFlatOutline(cache, key);
+	if(!flat)
+	{
+		MyPreparedOutline prepared;
+		ExtractOutline(&prepared, face, character);
+		flat = AddFlatOutline(cache, key, prepared.segments.data(), prepared.contourEnds.data(),
+		                      prepared.contourEnds.size());
+	}
+	return InsideFlatOutline(flat, originX - floor(originX) + localX, y * emPixels);
+}
+
+// the run drawn in the current scene, if there is one
+MyTextRun *ShownRun(MyTextRun *runs)
+{
+	if(scene == 3)
+		return &runs[font - 1];
 	if(scene == 4)
+		return &runs[3 + moreFont - 1];
+	return 0;
+}
+
+// on release, reports the glyph whose ink is under a click, or every glyph
+// overlapping the rectangle dragged out since the press; emPixels is the
+// number of pixels an EM covers
+void SelectGlyphs(MySelection *selection, MyFlatCache *cache, MyTextRun *run, const MyInputEvent &event,
+                  float emPixels)
+{
+	if(event.action == GLFW_PRESS)
 	{
-		int helper;
-		for(int i = 0; i < u; i++)
-		{
-			vertices[i][0] += delta;
-		}	
-		delta = delta - delta2;
-		
-		if(moreFont == 2 || moreFont == 3)
-			helper = 12;
-		else
-			helper = 0;
-		
-		if (vertices[u-1][0] < -16 + helper)
-			delta = 1;
+		selection->dragging = true;
+		selection->viewX = event.x;
+		selection->viewY = event.y;
+		ViewToRun(event.x, event.y, &selection->x, &selection->y);
+		return;
 	}
+	if(event.action != GLFW_RELEASE || !selection->dragging)
+		return;
+	selection->dragging = false;
+	if(!run)
+		return;
 
+	float x, y;
+	ViewToRun(event.x, event.y, &x, &y);
+	string text;
 
-    geometry->elementCount = 20;
+	if(fabs(event.x - selection->viewX) <= CLICK_SLOP && fabs(event.y - selection->viewY) <= CLICK_SLOP)
+	{
+		// of the glyphs whose boxes hold the point, the last in the text with
+		// ink there is the one drawn on top
+		MyBounds point;
+		GrowBounds(point, x, y);
+		ArenaVector<int> boxes((MyArenaAllocator<int>(&frameArena)));
+		QueryRange(&run->index, point, boxes);
+
+		float cursorX = (event.x + 1) * emPixels / SceneScale(scene);
+		int glyph = -1;
+		for(uint i = 0; i < boxes.size(); i++)
+			if(boxes[i] > glyph && OnGlyphInk(cache, run, boxes[i], x, y, emPixels, cursorX))
+				glyph = boxes[i];
+		if(glyph < 0)
+			return;
+		EncodeUtf8((*run->text)[glyph], text);
+		cout << "Glyph " << glyph << ": " << text << endl;
+		return;
+	}
 
-    // these vertex attribute indices correspond to those specified for the
-    // input variables in the vertex shader
-    const GLuint VERTEX_INDEX = 0;
-    const GLuint COLOUR_INDEX = 1;
+	MyBounds range;
+	GrowBounds(range, selection->x, selection->y);
+	GrowBounds(range, x, y);
+	ArenaVector<int> glyphs((MyArenaAllocator<int>(&frameArena)));
+	QueryRange(&run->index, range, glyphs);
+	if(glyphs.empty())
+		return;
+
+	sort(glyphs.begin(), glyphs.end());
+	for(uint i = 0; i < glyphs.size(); i++)
+		EncodeUtf8((*run->text)[glyphs[i]], text);
+	cout << "Selected " << glyphs.size() << " glyphs: " << text << endl;
+}
 
-    // create an array buffer object for storing our vertices
-    glGenBuffers(1, &geometry->vertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+// --------------------------------------------------------------------------
+// Streaming buffer for data rewritten every frame
 
-    // create another one for storing our colours
-    glGenBuffers(1, &geometry->colourBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->colourBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(curveColours), curveColours, GL_STATIC_DRAW);
-    
-    // create a vertex array object encapsulating all our vertex attributes
-    glGenVertexArrays(1, &geometry->vertexArray);
-    glBindVertexArray(geometry->vertexArray);
+// number of regions in a stream ring, so the CPU can fill one while the GPU
+// may still be reading the two frames before it
+const int STREAM_REGIONS = 3;
 
-    // associate the position array with the vertex array object
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->vertexBuffer);
-    glVertexAttribPointer(VERTEX_INDEX, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(VERTEX_INDEX);
+struct MyStreamRing
+{
+    // OpenGL name for the ring's buffer, and the binding it is written through
+    GLuint      buffer;
+    GLenum      target;
 
-    // assocaite the colour array with the vertex array object
-    glBindBuffer(GL_ARRAY_BUFFER, geometry->colourBuffer);
-    glVertexAttribPointer(COLOUR_INDEX, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(COLOUR_INDEX);
+    // size of each region in bytes, the region written this frame, and a
+    // fence after the last commands that read each region
+    GLsizeiptr  regionSize;
+    int         region;
+    GLsync      fences[STREAM_REGIONS];
 
-    // unbind our buffers, resetting to default state
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // start of the whole buffer when it is persistently mapped, otherwise
+    // null and each region is mapped as it is written
+    char       *persistent;
+
+    // initialize object names to zero (OpenGL reserved value)
+    MyStreamRing() : buffer(0), target(GL_ARRAY_BUFFER), regionSize(0), region(0), persistent(0)
+    {
+        for (int i = 0; i < STREAM_REGIONS; i++)
+            fences[i] = 0;
+    }
+};
+
+// set at startup when buffers can be given immutable, persistently mapped
+// storage (OpenGL 4.4 or ARB_buffer_storage)
+bool hasBufferStorage = false;
+
+// allocates a ring of STREAM_REGIONS regions of the given size, once, for
+// the given binding target, returning true if successful
+bool InitializeStreamRing(MyStreamRing *ring, GLenum target, GLsizeiptr regionSize)
+{
+    ring->target = target;
+    ring->regionSize = regionSize;
+    ring->region = STREAM_REGIONS - 1;
+
+    glGenBuffers(1, &ring->buffer);
+    glBindBuffer(target, ring->buffer);
+
+#ifdef GL_VERSION_4_4
+    if (hasBufferStorage)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, STREAM_REGIONS * regionSize, 0, flags);
+        ring->persistent = static_cast<char *>(glMapBufferRange(target, 0, STREAM_REGIONS * regionSize, flags));
+    }
+    else
+#endif
+        glBufferData(target, STREAM_REGIONS * regionSize, 0, GL_STREAM_DRAW);
+
+    glBindBuffer(target, 0);
+
+    // check for OpenGL errors and return false if error occurred
+    return !CheckGLErrors();
+}
+
+// moves on to the next region, waiting only if the GPU has not yet finished
+// the frame that last used it, and returns where size bytes may be written;
+// the byte offset of the region in the buffer is returned through offset
+void *MapStreamRegion(MyStreamRing *ring, GLsizeiptr size, GLintptr *offset)
+{
+    if (size > ring->regionSize)
+    {
+        cout << "ERROR: " << size << " bytes do not fit a stream region of "
+             << ring->regionSize << endl;
+        return 0;
+    }
+
+    ring->region = (ring->region + 1) % STREAM_REGIONS;
+    *offset = ring->region * ring->regionSize;
+
+    GLsync &fence = ring->fences[ring->region];
+    if (fence)
+    {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+            ;
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    if (ring->persistent)
+        return ring->persistent + *offset;
+
+    // the fence already guarantees the region is idle, so the driver need
+    // not synchronise or keep the old contents
+    glBindBuffer(ring->target, ring->buffer);
+    return glMapBufferRange(ring->target, *offset, size,
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void UnmapStreamRegion(MyStreamRing *ring)
+{
+    if (ring->persistent)
+        return;
+
+    glUnmapBuffer(ring->target);
+    glBindBuffer(ring->target, 0);
+}
+
+// marks the current region as in use until the commands issued so far finish
+void FenceStreamRegion(MyStreamRing *ring)
+{
+    GLsync &fence = ring->fences[ring->region];
+    if (fence)
+        glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void DestroyStreamRing(MyStreamRing *ring)
+{
+    for (int i = 0; i < STREAM_REGIONS; i++)
+        if (ring->fences[i])
+            glDeleteSync(ring->fences[i]);
+
+    if (ring->persistent)
+    {
+        glBindBuffer(ring->target, ring->buffer);
+        glUnmapBuffer(ring->target);
+        glBindBuffer(ring->target, 0);
+    }
+    glDeleteBuffers(1, &ring->buffer);
+}
+
+// --------------------------------------------------------------------------
+// Indirect draw commands for the glyph runs visible in a frame
+
+// record layout of DrawArraysIndirectCommand from the OpenGL specification
+struct MyDrawCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+};
+
+struct MyCommandBuffer
+{
+    // ring the indirect draws are streamed through, and the byte offset of
+    // this frame's commands within it
+    MyStreamRing ring;
+    GLintptr     base;
+
+    // commands for the outline pass of each curve degree, and the fill
+    // stencil and fill cover passes, which are uploaded back to back in that
+    // order
+    vector<MyDrawCommand> outline[4];
+    vector<MyDrawCommand> stencil;
+    vector<MyDrawCommand> cover;
+
+    MyCommandBuffer() : base(0)
+    {}
+};
+
+// set at startup when the context can source draws from an indirect buffer
+bool hasMultiDrawIndirect = false;
+
+// sizes the command stream for the case of every run being visible at once,
+// returning true if successful
+bool InitializeCommandBuffer(MyCommandBuffer *commands, MyTextRun *runs, int runCount)
+{
+	if(!hasMultiDrawIndirect)
+		return true;
+
+	size_t batches = 0;
+	for(int r = 0; r < runCount; r++)
+		batches += runs[r].batches.size();
+
+	// up to four outline commands, a stencil and a cover command per batch
+	return InitializeStreamRing(&commands->ring, GL_DRAW_INDIRECT_BUFFER,
+	                            max<size_t>(batches, 1) * 6 * sizeof(MyDrawCommand));
+}
+
+void AddCommand(vector<MyDrawCommand> &commands, GLuint first, GLuint count, const MyGlyphBatch &batch)
+{
+    MyDrawCommand command = { count, GLuint(batch.instanceCount), first, GLuint(batch.firstInstance) };
+    commands.push_back(command);
+}
+
+// number of outline commands of all degrees, which precede the fill commands
+size_t OutlineCommands(const MyCommandBuffer *commands)
+{
+	size_t count = 0;
+	for(int d = 0; d < 4; d++)
+		count += commands->outline[d].size();
+	return count;
+}
+
+// number of pixels an EM of laid out text covers in the current scene
+float EmPixels()
+{
+	return SceneScale(scene) * framebufferHeight / 2;
+}
+
+// the coarsest level of detail that strays by at most lodPixels on screen,
+// given how many pixels an EM covers in the current scene
+int DetailLevel()
+{
+	float emPixels = EmPixels();
+
+	int level = 0;
+	while(level + 1 < LOD_LEVELS && lodTolerance[level + 1] * emPixels <= lodPixels)
+		level++;
+	return level;
+}
+
+// records the draws of every visible run for each pass, with outlines drawn
+// at the given level of detail; glyphs are looked up in each run's index and
+// only the instances of a batch from its first to its last glyph overlapping
+// the view are drawn, which for a run set on one line is just those in view
+void BuildCommands(MyCommandBuffer *commands, MyOutlineStore *store, MyTextRun **runs, int runCount,
+                   int level, const MyBounds &view)
+{
+	for(int d = 0; d < 4; d++)
+		commands->outline[d].clear();
+	commands->stencil.clear();
+	commands->cover.clear();
+
+	// scratch for culling, from the frame arena: the glyphs of a run in view,
+	// and the part of each of its batches they fall in
+	ArenaVector<int> inView((MyArenaAllocator<int>(&frameArena)));
+	ArenaVector<MyGlyphBatch> culled((MyArenaAllocator<MyGlyphBatch>(&frameArena)));
+
+	for(int r = 0; r < runCount; r++)
+	{
+		inView.clear();
+		QueryRange(&runs[r]->index, view, inView);
+
+		MyGlyphBatch none = { 0, 0, 0 };
+		culled.assign(runs[r]->batches.size(), none);
+		for(uint i = 0; i < inView.size(); i++)
+		{
+			const MyGlyphSlot &slot = runs[r]->slots[inView[i]];
+			MyGlyphBatch &part = culled[slot.batch];
+			if(part.instanceCount == 0)
+			{
+				part.firstInstance = slot.instance;
+				part.instanceCount = 1;
+				continue;
+			}
+			GLint last = max(part.firstInstance + part.instanceCount - 1, slot.instance);
+			part.firstInstance = min(part.firstInstance, slot.instance);
+			part.instanceCount = last - part.firstInstance + 1;
+		}
+
+		for(uint i = 0; i < runs[r]->batches.size(); i++)
+		{
+			MyGlyphBatch &batch = culled[i];
+			if(batch.instanceCount == 0)
+				continue;
+			batch.outline = runs[r]->batches[i].outline;
+
+			const MyOutline &outline = store->outlines[batch.outline];
+			const MyOutlineLevel &detail = outline.levels[level];
+			GLuint first = detail.first;
+			for(int d = 0; d < 4; d++)
+			{
+				if(detail.degreeCount[d] > 0)
+					AddCommand(commands->outline[d], first, detail.degreeCount[d], batch);
+				first += detail.degreeCount[d];
+			}
+			AddCommand(commands->stencil, outline.fillFirst, outline.fillCount, batch);
+			AddCommand(commands->cover, outline.fillFirst + outline.fillCount, 6, batch);
+		}
+	}
+
+	if(!hasMultiDrawIndirect)
+		return;
+
+	size_t n0 = OutlineCommands(commands), n1 = commands->stencil.size(), n2 = commands->cover.size();
+	if(n0 + n1 + n2 == 0)
+		return;
+
+	// write straight into a free region of the ring rather than reallocating
+	MyDrawCommand *mapped = static_cast<MyDrawCommand *>(
+		MapStreamRegion(&commands->ring, (n0 + n1 + n2) * sizeof(MyDrawCommand), &commands->base));
+	if(!mapped)
+		return;
+	for(int d = 0; d < 4; d++)
+		mapped = copy(commands->outline[d].begin(), commands->outline[d].end(), mapped);
+	mapped -= n0;
+	copy(commands->stencil.begin(), commands->stencil.end(), mapped + n0);
+	copy(commands->cover.begin(), commands->cover.end(), mapped + n0 + n1);
+	UnmapStreamRegion(&commands->ring);
+}
+
+// issues one pass of commands: a single multi-draw where it is available
+// (OpenGL 4.3), otherwise one instanced draw per command with the instance
+// attribute moved to each command's base instance
+void SubmitCommands(MyCommandBuffer *commands, MyOutlineStore *store, GLenum mode,
+                    GLuint instanceIndex, const vector<MyDrawCommand> &list, size_t offset)
+{
+	if(list.empty())
+		return;
 
-	glPatchParameteri(GL_PATCH_VERTICES, 4);
+#ifdef GL_VERSION_4_3
+	if(hasMultiDrawIndirect)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands->ring.buffer);
+		glMultiDrawArraysIndirect(mode, reinterpret_cast<void *>(commands->base + offset * sizeof(MyDrawCommand)),
+		                          list.size(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		return;
+	}
+#endif
 
-    // check for OpenGL errors and return false if error occurred
-    return !CheckGLErrors();
+	for(uint i = 0; i < list.size(); i++)
+	{
+		SelectInstances(store, instanceIndex, list[i].baseInstance);
+		glDrawArraysInstanced(mode, list[i].first, list[i].count, list[i].instanceCount);
+	}
+	SelectInstances(store, instanceIndex, 0);
 }
-// deallocate geometry-related objects
-void DestroyGeometry(MyGeometry *geometry)
+
+// marks this frame's commands as in use until the passes reading them finish
+void FenceCommands(MyCommandBuffer *commands)
 {
-    // unbind and destroy our vertex array object and associated buffers
-    glBindVertexArray(0);
-    glDeleteVertexArrays(1, &geometry->vertexArray);
-    glDeleteBuffers(1, &geometry->vertexBuffer);
-    glDeleteBuffers(1, &geometry->colourBuffer);
+	if(hasMultiDrawIndirect && commands->ring.buffer)
+		FenceStreamRegion(&commands->ring);
+}
+
+void DestroyCommandBuffer(MyCommandBuffer *commands)
+{
+    if (commands->ring.buffer)
+        DestroyStreamRing(&commands->ring);
 }
 
 // --------------------------------------------------------------------------
 // Rendering function that draws our scene to the frame buffer
 
-void RenderGlyphs(MyGeometry *geometry, MyShader *shader, vector<int> *degrees)
+void RenderGlyphs(MyCommandBuffer *commands, MyOutlineStore *store, MyShaderCache *shaders)
 {
-	glUseProgram(shader->program);
-    
-    int sceLoc = glGetUniformLocation(shader->program, "scene");    
-    int curLoc = glGetUniformLocation(shader->program, "curveType");    
-    glUniform1i(sceLoc, scene);
-    
-    glBindVertexArray(geometry->vertexArray);
-	
-	if(scene == 3 || scene == 4)
+    glBindVertexArray(store->vertexArray);
+
+	// one submission per degree, each drawn by the program built for it
+	size_t offset = 0;
+	for(int d = 0; d < 4; d++)
 	{
-		for(uint i = 0; i < degrees->size(); i++)
-		{
-			glUniform1i(curLoc, degrees->at(i));
-			glDrawArrays(GL_PATCHES, i*4, 4);
-		}
-	}		
+		if(commands->outline[d].empty())
+			continue;
+
+		glUseProgram(GetShader(shaders, OUTLINE_PROGRAM, scene, d)->program);
+		glPatchParameteri(GL_PATCH_VERTICES, d + 1);
+		SubmitCommands(commands, store, GL_PATCHES, 1, commands->outline[d], offset);
+		offset += commands->outline[d].size();
+	}
 
     // reset state to default (no shader or geometry bound)
     glBindVertexArray(0);
@@ -452,46 +1692,58 @@ void RenderGlyphs(MyGeometry *geometry, MyShader *shader, vector<int> *degrees)
     // check for an report any OpenGL errors
     CheckGLErrors();
 }
-void RenderGlyphLine(MyGeometry *geometry, MyShader *shader, vector<int> *degrees)
+
+void RenderGlyphLine(MyTextRun *run, MyOutlineStore *store, MyShaderCache *shaders)
 {
 	 // clear screen to a dark grey colour
     
     // bind our shader program and the vertex array object containing our
     // scene geometry, then tell OpenGL to draw our geometry
+    MyShader *shader = GetShader(shaders, LINE_PROGRAM, scene);
     glUseProgram(shader->program);
-    glBindVertexArray(geometry->vertexArray);
+    glBindVertexArray(store->vertexArray);
 	
-	int sceLoc = glGetUniformLocation(shader->program, "scene");           
-	int colLoc = glGetUniformLocation(shader->program, "colorType");           
-    glUniform1i(sceLoc, scene);
+	int colLoc = shader->colorType;
 	
 	if((version == 2) && (scene == 3))
 	{
-		//tangent lines		
-		for(uint i = 0; i <  (4 * degrees->size()); i++)
-		{
-			glUniform1f(colLoc, 0.7);
-			if((i % 4) == 0) 
-				glDrawArrays(GL_LINES, i, 3);
-		}
-		
-		//off line control points
-		glPointSize(4);
-		for(uint i = 0; i < (4 * degrees->size()); i++)
-		{
-			glUniform1f(colLoc, 0.7);
-			if((i % 4) == 1)
-				glDrawArrays(GL_POINTS, i, 1);
-		}
-		
-		//on line control points
-		glPointSize(4);
-		for(uint i = 0; i < (4 * degrees->size()); i++)
+		for(uint g = 0; g < run->batches.size(); g++)
 		{
-			glUniform1f(colLoc, 0.0);
-			if(((i % 4) == 0) || ((i % 4) == 2))
-				glDrawArrays(GL_POINTS, i, 1);
+			const MyOutline &outline = store->outlines[run->batches[g].outline];
+			const MyOutlineLevel &detail = outline.levels[0];
+			int instances = run->batches[g].instanceCount;
+			SelectInstances(store, 1, run->batches[g].firstInstance);
+
+			// the segments of each degree lie together, degree + 1 points
+			// apiece, after the lone points of any of degree zero
+			int first = detail.first + detail.degreeCount[0];
+			for(int d = 1; d < 4; d++)
+			{
+				int last = first + detail.degreeCount[d];
+
+				//tangent lines
+				glUniform1f(colLoc, 0.7);
+				for(int i = first; i < last; i += d + 1)
+					glDrawArraysInstanced(GL_LINE_STRIP, i, d + 1, instances);
+
+				//off line control points
+				glPointSize(4);
+				glUniform1f(colLoc, 0.7);
+				for(int i = first; d > 1 && i < last; i += d + 1)
+					glDrawArraysInstanced(GL_POINTS, i + 1, d - 1, instances);
+
+				//on line control points
+				glPointSize(4);
+				glUniform1f(colLoc, 0.0);
+				for(int i = first; i < last; i += d + 1)
+				{
+					glDrawArraysInstanced(GL_POINTS, i, 1, instances);
+					glDrawArraysInstanced(GL_POINTS, i + d, 1, instances);
+				}
+				first = last;
+			}
 		}
+		SelectInstances(store, 1, 0);
 	}	
 	
     // reset state to default (no shader or geometry bound)
@@ -501,20 +1753,64 @@ void RenderGlyphLine(MyGeometry *geometry, MyShader *shader, vector<int> *degree
     // check for an report any OpenGL errors
     CheckGLErrors();
 }
-void RenderScene(MyGeometry *geometry, MyShader *shader)
+
+// fills a string of glyphs by counting windings into the stencil buffer and
+// then covering every sample with a non-zero count
+void RenderGlyphFill(MyCommandBuffer *commands, MyOutlineStore *store, MyShaderCache *shaders)
+{
+	MyShader *shader = GetShader(shaders, FILL_PROGRAM, scene);
+	glUseProgram(shader->program);
+
+
+	glBindVertexArray(store->fillArray);
+	glEnable(GL_STENCIL_TEST);
+
+	// front facing triangles wind up, back facing triangles wind down
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glStencilFunc(GL_ALWAYS, 0, 0xFF);
+	glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
+	glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
+	size_t n0 = OutlineCommands(commands);
+	SubmitCommands(commands, store, GL_TRIANGLES, 2, commands->stencil, n0);
+
+	// cover the glyphs, clearing the stencil again as we go
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+	glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+	SubmitCommands(commands, store, GL_TRIANGLES, 2, commands->cover,
+	               n0 + commands->stencil.size());
+
+	glDisable(GL_STENCIL_TEST);
+
+    // reset state to default (no shader or geometry bound)
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    // check for an report any OpenGL errors
+    CheckGLErrors();
+}
+
+void RenderScene(MyGeometry *geometry, MyShaderCache *shaders)
 {
+    // the second scene holds cubics and the others quadratics
+    if (scene == 4)
+        return;
+    MyShader *shader = GetShader(shaders, OUTLINE_PROGRAM, scene, (scene == 2) ? 3 : 2);
+
     // bind our shader program and the vertex array object containing our
     // scene geometry, then tell OpenGL to draw our geometry
     glUseProgram(shader->program);
     
-    int sceLoc = glGetUniformLocation(shader->program, "scene");    
-    glUniform1i(sceLoc, scene);
+    // the scene curves have no instance array, so the EM scale of their grid
+    // comes from the current value of the instance attribute
+    glVertexAttrib3f(1, 0, 0, (scene == 1) ? 0.5 / 25 : 0.5 / 90);
 
     glBindVertexArray(geometry->vertexArray);
+    glPatchParameteri(GL_PATCH_VERTICES, (scene == 2) ? 4 : 3);
     if(scene == 1)
-		glDrawArrays(GL_PATCHES, 0, 16);
+		glDrawArrays(GL_PATCHES, 0, 12);
 	if(scene == 2)
-		glDrawArrays(GL_PATCHES, 16, 20);
+		glDrawArrays(GL_PATCHES, 12, 20);
 	if(scene == 3)
 		glDrawArrays(GL_PATCHES, 0, 3);
 
@@ -526,46 +1822,46 @@ void RenderScene(MyGeometry *geometry, MyShader *shader)
     CheckGLErrors();
 }
 
-void RenderLineScene(MyGeometry *geometry, MyShader *shader)
+void RenderLineScene(MyGeometry *geometry, MyShaderCache *shaders)
 {
 	 // clear screen to a dark grey colour
     glClearColor(0.0, 0.0, 0.0, 1.0);
-    glClear(GL_COLOR_BUFFER_BIT);
+    glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
     
     // bind our shader program and the vertex array object containing our
     // scene geometry, then tell OpenGL to draw our geometry
+    MyShader *shader = GetShader(shaders, LINE_PROGRAM, scene);
     glUseProgram(shader->program);
     glBindVertexArray(geometry->vertexArray);
 	
-	int sceLoc = glGetUniformLocation(shader->program, "scene");           
-	int colLoc = glGetUniformLocation(shader->program, "colorType");           
-    glUniform1i(sceLoc, scene);
+	int colLoc = shader->colorType;
+    glVertexAttrib3f(1, 0, 0, (scene == 1) ? 0.5 / 25 : 0.5 / 90);
 	
 	if((version == 2) && (scene == 1))
 	{
 		//tangent lines		
-		for(int i = 0; i <  16; i++)
+		glUniform1f(colLoc, 0.7);
+		for(int i = 0; i < 12; i++)
 		{
-			glUniform1f(colLoc, 0.7);
-			if((i % 4) == 0) 
+			if((i % 3) == 0) 
 				glDrawArrays(GL_LINE_STRIP, i, 3);
 		}
 		
 		//off line control points
 		glPointSize(4);
-		for(int i = 0; i < 16; i++)
+		glUniform1f(colLoc, 0.7);
+		for(int i = 0; i < 12; i++)
 		{
-			glUniform1f(colLoc, 0.7);
-			if((i % 4) == 1)
+			if((i % 3) == 1)
 				glDrawArrays(GL_POINTS, i, 1);
 		}
 		
 		//on line control points
 		glPointSize(4);
-		for(int i = 0; i < 16; i++)
+		glUniform1f(colLoc, 0.0);
+		for(int i = 0; i < 12; i++)
 		{
-			glUniform1f(colLoc, 0.0);
-			if(((i % 4) == 0) || ((i % 4) == 2))
+			if(((i % 3) == 0) || ((i % 3) == 2))
 				glDrawArrays(GL_POINTS, i, 1);
 		}
 	}
@@ -573,29 +1869,29 @@ void RenderLineScene(MyGeometry *geometry, MyShader *shader)
 	if((version == 2) && (scene == 2))
 	{
 		//tangent lines
+		glUniform1f(colLoc, 0.7);
 		for(int i = 0; i <  20; i++)
 		{
-			glUniform1f(colLoc, 0.7);
 			if((i % 4) == 0) 
-				glDrawArrays(GL_LINE_STRIP, i+16, 4);
+				glDrawArrays(GL_LINE_STRIP, i+12, 4);
 		}
 		
 		//off line control points
 		glPointSize(4);
+		glUniform1f(colLoc, 0.7);
 		for(int i = 0; i < 20; i++)
 		{
-			glUniform1f(colLoc, 0.7);
 			if(((i % 4) == 1) || ((i % 4) == 2))
-				glDrawArrays(GL_POINTS, i+16, 1);
+				glDrawArrays(GL_POINTS, i+12, 1);
 		}
 		
 		//on line control points
 		glPointSize(4);
+		glUniform1f(colLoc, 0.0);
 		for(int i = 0; i < 20; i++)
 		{
-			glUniform1f(colLoc, 0.0);
 			if(((i % 4) == 0) || ((i % 4) == 3))
-				glDrawArrays(GL_POINTS, i+16, 1);
+				glDrawArrays(GL_POINTS, i+12, 1);
 		}
 	}
 	
@@ -608,6 +1904,110 @@ void RenderLineScene(MyGeometry *geometry, MyShader *shader)
     CheckGLErrors();
 }
 
+// --------------------------------------------------------------------------
+// Input-to-display latency, gathered into a histogram per kind of input
+
+enum MyLatencyKind { LATENCY_SCENE, LATENCY_FONT, LATENCY_OTHER, LATENCY_KINDS };
+
+// upper bounds of the histogram buckets in milliseconds; the last bucket
+// takes everything above the last bound
+const double LATENCY_BOUNDS[] = { 1, 2, 4, 8, 16, 33, 50, 67, 100, 250 };
+const int LATENCY_BUCKETS = sizeof(LATENCY_BOUNDS) / sizeof(LATENCY_BOUNDS[0]) + 1;
+
+struct MyLatencyStats
+{
+    // per kind of input: samples in each bucket, their total and maximum
+    long   counts[LATENCY_KINDS][LATENCY_BUCKETS];
+    double total[LATENCY_KINDS];
+    double worst[LATENCY_KINDS];
+
+    // inputs applied since the last frame was shown: kind and callback time
+    vector<pair<int, double> > pending;
+
+    MyLatencyStats()
+    {
+        for (int k = 0; k < LATENCY_KINDS; k++)
+        {
+            for (int b = 0; b < LATENCY_BUCKETS; b++)
+                counts[k][b] = 0;
+            total[k] = worst[k] = 0;
+        }
+    }
+};
+
+// remembers a key press until the frame that first reflects it is shown
+void TrackLatency(MyLatencyStats *stats, const MyInputEvent &event)
+{
+    if (event.type != INPUT_KEY || event.action != GLFW_PRESS)
+        return;
+
+    int kind = LATENCY_OTHER;
+    if (event.key >= GLFW_KEY_1 && event.key <= GLFW_KEY_4)
+        kind = LATENCY_SCENE;
+    if (event.key == GLFW_KEY_A || event.key == GLFW_KEY_S || event.key == GLFW_KEY_D ||
+        event.key == GLFW_KEY_Z || event.key == GLFW_KEY_X || event.key == GLFW_KEY_C)
+        kind = LATENCY_FONT;
+    stats->pending.push_back(make_pair(kind, event.time));
+}
+
+// called once a frame has been swapped: waits for it to be fully drawn and
+// records the latency of every input it was the first to show
+void RecordLatency(MyLatencyStats *stats)
+{
+    if (stats->pending.empty())
+        return;
+
+    glFinish();
+    double shown = glfwGetTime();
+
+    for (size_t i = 0; i < stats->pending.size(); i++)
+    {
+        int kind = stats->pending[i].first;
+        double ms = (shown - stats->pending[i].second) * 1000;
+
+        int b = 0;
+        while (b < LATENCY_BUCKETS - 1 && ms > LATENCY_BOUNDS[b])
+            b++;
+        stats->counts[kind][b]++;
+        stats->total[kind] += ms;
+        stats->worst[kind] = max(stats->worst[kind], ms);
+    }
+    stats->pending.clear();
+}
+
+// writes the histograms out as text, one block per kind of input
+void WriteLatency(const MyLatencyStats *stats, const string &filename)
+{
+    ofstream output(filename.c_str());
+    if (!output)
+    {
+        cout << "ERROR: Could not write latency histogram to " << filename << endl;
+        return;
+    }
+
+    const char *names[LATENCY_KINDS] = { "scene keys (1-4)", "font keys (A/S/D, Z/X/C)", "other keys" };
+    for (int k = 0; k < LATENCY_KINDS; k++)
+    {
+        long samples = 0;
+        for (int b = 0; b < LATENCY_BUCKETS; b++)
+            samples += stats->counts[k][b];
+
+        output << names[k] << ": " << samples << " samples";
+        if (samples > 0)
+            output << ", mean " << stats->total[k] / samples << " ms, max " << stats->worst[k] << " ms";
+        output << endl;
+
+        for (int b = 0; b < LATENCY_BUCKETS; b++)
+        {
+            if (b < LATENCY_BUCKETS - 1)
+                output << "  <= " << LATENCY_BOUNDS[b] << " ms\t";
+            else
+                output << "  >  " << LATENCY_BOUNDS[b - 1] << " ms\t";
+            output << stats->counts[k][b] << endl;
+        }
+    }
+}
+
 // --------------------------------------------------------------------------
 // GLFW callback functions
 
@@ -618,11 +2018,84 @@ void ErrorCallback(int error, const char* description)
     cout << description << endl;
 }
 
-// handles keyboard input events
+// redraws when the window system has discarded the window contents
+void RefreshCallback(GLFWwindow* window)
+{
+    MyInputEvent event = { INPUT_REFRESH, 0, 0, glfwGetTime(), 0, 0, 0, 0 };
+    PushInput(&inputQueue, event);
+}
+
+// passes the new framebuffer size to the render thread, since GLFW only
+// lets the main thread ask for it
+void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
+{
+    MyInputEvent event = { INPUT_RESIZE, 0, 0, glfwGetTime(), 0, 0, width, height };
+    while (!PushInput(&inputQueue, event))
+        this_thread::yield();
+}
+
+// handles keyboard input events on the GLFW event thread, passing them on
+// to the render thread that owns the state they change
 void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GL_TRUE);
+
+    MyInputEvent event = { INPUT_KEY, key, action, glfwGetTime(), 0, 0, 0, 0 };
+    if (!PushInput(&inputQueue, event))
+        cout << "ERROR: input queue full, key " << key << " dropped" << endl;
+}
+
+// passes left button presses and releases on to the render thread, with the
+// cursor position in view coordinates
+void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (button != GLFW_MOUSE_BUTTON_LEFT)
+        return;
+
+    double x, y;
+    int width, height;
+    glfwGetCursorPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    if (width <= 0 || height <= 0)
+        return;
+
+    MyInputEvent event = { INPUT_MOUSE, button, action, glfwGetTime(),
+                           float(2 * x / width - 1), float(1 - 2 * y / height), 0, 0 };
+    if (!PushInput(&inputQueue, event))
+        cout << "ERROR: input queue full, click dropped" << endl;
+}
+
+// applies an input event on the render thread
+void ApplyInput(const MyInputEvent &event)
+{
+    if (event.type == INPUT_RESIZE)
+    {
+        // a new size changes the detail level outlines are drawn at
+        framebufferWidth = event.width;
+        framebufferHeight = event.height;
+        dirty |= DIRTY_FRAME | DIRTY_COMMANDS;
+        return;
+    }
+    if (event.type == INPUT_REFRESH)
+    {
+        dirty |= DIRTY_FRAME;
+        return;
+    }
+
+    int key = event.key;
+    int action = event.action;
+
+    // every key acts on press; those choosing the scene or a font change
+    // which glyph runs are drawn
+    if (action == GLFW_PRESS)
+        dirty |= DIRTY_FRAME;
+    if (action == GLFW_PRESS && (key == GLFW_KEY_1 || key == GLFW_KEY_2 || key == GLFW_KEY_3 ||
+                                 key == GLFW_KEY_4 || key == GLFW_KEY_A || key == GLFW_KEY_S ||
+                                 key == GLFW_KEY_D || key == GLFW_KEY_Z || key == GLFW_KEY_X ||
+                                 key == GLFW_KEY_C))
+        dirty |= DIRTY_COMMANDS;
+
     if (key == GLFW_KEY_1 && action == GLFW_PRESS)
 		scene = 1;		
 	if (key == GLFW_KEY_2 && action == GLFW_PRESS)
@@ -649,6 +2122,10 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 		moreFont = 2;	
 	if (key == GLFW_KEY_C && action == GLFW_PRESS)
 		moreFont = 3;	
+	if (key == GLFW_KEY_F && action == GLFW_PRESS)
+		filled = 1;
+	if (key == GLFW_KEY_G && action == GLFW_PRESS)
+		filled = 0;
 	if (key == GLFW_KEY_RIGHT && action == GLFW_PRESS)
 		delta2 = delta2 * 0.9;	
 	if (key == GLFW_KEY_LEFT && action == GLFW_PRESS)
@@ -658,6 +2135,8 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 // ==========================================================================
 // PROGRAM ENTRY POINT
 
+int RunRenderer(GLFWwindow *window, double refreshPeriod);
+
 int main(int argc, char *argv[])
 {
     // initialize the GLFW windowing system
@@ -674,6 +2153,7 @@ int main(int argc, char *argv[])
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_SAMPLES,4);
+    glfwWindowHint(GLFW_STENCIL_BITS, 8);
     window = glfwCreateWindow(512, 512, "CPSC 453 OpenGL Boilerplate", 0, 0);
     if (!window) {
         cout << "Program failed to create GLFW window, TERMINATING" << endl;
@@ -681,10 +2161,65 @@ int main(int argc, char *argv[])
         return -1;
     }
 
-    // set keyboard callback function and make our context current (active)
+    // set keyboard callback function; the context is made current on the
+    // render thread, which does all drawing
     glfwSetKeyCallback(window, KeyCallback);
+    glfwSetMouseButtonCallback(window, MouseButtonCallback);
+    glfwSetWindowRefreshCallback(window, RefreshCallback);
+    glfwSetFramebufferSizeCallback(window, FramebufferSizeCallback);
+
+    // the render thread learns the framebuffer size through the input queue,
+    // starting with its size now
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    FramebufferSizeCallback(window, width, height);
+
+    // animations are paced by the display
+    double refreshPeriod = 1.0 / 60;
+    const GLFWvidmode *mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    if (mode && mode->refreshRate > 0)
+        refreshPeriod = 1.0 / mode->refreshRate;
+
+    // this thread only waits on window events from here on, so input is
+    // handled promptly however long the render thread spends on a frame
+    int result = 0;
+    InitializeJobs();
+    thread renderer([&]() { result = RunRenderer(window, refreshPeriod); });
+    while (!glfwWindowShouldClose(window))
+        glfwWaitEvents();
+
+    MyInputEvent closing = { INPUT_CLOSE, 0, 0, glfwGetTime(), 0, 0, 0, 0 };
+    while (!PushInput(&inputQueue, closing))
+        this_thread::yield();
+    renderer.join();
+    DestroyJobs();
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+
+    cout << "Goodbye!" << endl;
+    return result;
+}
+
+// --------------------------------------------------------------------------
+// Render thread: owns the OpenGL context and every piece of state drawn
+
+// ends the program from the render thread when it cannot continue
+int StopRenderer(GLFWwindow *window)
+{
+    glfwSetWindowShouldClose(window, GL_TRUE);
+    glfwPostEmptyEvent();
+    glfwMakeContextCurrent(0);
+    return -1;
+}
+
+int RunRenderer(GLFWwindow *window, double refreshPeriod)
+{
     glfwMakeContextCurrent(window);
 
+    // pace animated frames to the display
+    glfwSwapInterval(1);
+
     //Load Inconsolata font and print some info
   	GlyphExtractor* ge = new GlyphExtractor();
     if(!ge->LoadFontFile("Lora-Regular.ttf"))
@@ -702,238 +2237,189 @@ int main(int argc, char *argv[])
     if(!ge4 ->LoadFontFile("AlexBrush-Regular.ttf"))
       cout << "font Inconsolata.otf loaded" << endl;
     
-	GlyphExtractor* ge5 = new GlyphExtractor();
-    if(!ge5 ->LoadFontFile("Inconsolata.otf"))
-      cout << "font Inconsolata.otf loaded" << endl;
-  
-	GlyphExtractor* ge6 = new GlyphExtractor();
-    if(!ge6 ->LoadFontFile("SourceSansPro-Regular.otf"))
-      cout << "font Inconsolata.otf loaded" << endl;
-  
-
     // query and print out information about our OpenGL environment
     QueryGLVersion();
 
-    // call function to load and compile shader programs
-    MyShader shader;
-    if (!InitializeShaders(&shader)) {
+    // call function to load and compile every shader program variant
+    MyShaderCache shaders;
+    if (!InitializeShaderCache(&shaders)) {
         cout << "Program could not initialize shaders, TERMINATING" << endl;
-        return -1;
+        return StopRenderer(window);
     }
-    MyShader lineShader;
-    if (!InitializeLineShaders(&lineShader)) {
-        cout << "Program could not initialize shaders, TERMINATING" << endl;
-        return -1;
+    MyFrameUniforms uniforms;
+    if (!InitializeFrameUniforms(&uniforms)) {
+        cout << "Program could not initialize uniforms, TERMINATING" << endl;
+        return StopRenderer(window);
     }
+	// text is given in UTF-8 and laid out by code point
+	vector<int> fName, bfString;
+	DecodeUtf8("Petras", fName);
+	DecodeUtf8("The quick brown fox jumps over the lazy dog.", bfString);
 	
-	vector<MyGlyph> fNameGlyphs;
-	vector<MyGlyph> fNameGlyphs2;
-	vector<MyGlyph> fNameGlyphs3;
-	vector<MyGlyph> bf;
-	vector<MyGlyph> bf2;
-	vector<MyGlyph> bf3;
-
-	vector<int> degrees;
-	vector<int> degrees2;
-	vector<int> degrees3;
-	vector<int> degrees4;
-	vector<int> degrees5;
-	vector<int> degrees6;
-
-
-	string fName = "Petras";
-	string bfString = "The quick brown fox jumps over the lazy dog.";
-	
-	//First name array init
-	for(uint i = 0; i < fName.size(); i++)
-	{
-		MyGlyph newGlyph = ge->ExtractGlyph(fName[i]);
-		fNameGlyphs.push_back(newGlyph);
-		MyGlyph newGlyph2 = ge2->ExtractGlyph(fName[i]);
-		fNameGlyphs2.push_back(newGlyph2);
-		MyGlyph newGlyph3 = ge3->ExtractGlyph(fName[i]);
-		fNameGlyphs3.push_back(newGlyph3);	
-	}
-	
-	for(uint i = 0; i < bfString.size(); i++)
-	{
-		MyGlyph newGlyph = ge4->ExtractGlyph(bfString[i]);
-		bf.push_back(newGlyph);
-		MyGlyph newGlyph2 = ge5->ExtractGlyph(bfString[i]);
-		bf2.push_back(newGlyph2);
-		MyGlyph newGlyph3 = ge6->ExtractGlyph(bfString[i]);
-		bf3.push_back(newGlyph3);	
-	}
-	
-
-	//find each degree of each seg from each contour from each glyph
-	for(uint i = 0; i < fNameGlyphs.size(); i++)
-	{
-		for(uint j = 0; j < fNameGlyphs[i].contours.size(); j++)
-		{
-			for(uint k = 0; k < fNameGlyphs[i].contours[j].size(); k++)
-			{	
-				degrees.push_back(fNameGlyphs[i].contours[j][k].degree);
-			}
-		}
-	}
-
-	for(uint i = 0; i < fNameGlyphs2.size(); i++)
-	{
-		for(uint j = 0; j < fNameGlyphs2[i].contours.size(); j++)
-		{
-			for(uint k = 0; k < fNameGlyphs2[i].contours[j].size(); k++)
-			{	
-				degrees2.push_back(fNameGlyphs2[i].contours[j][k].degree);
-			}
-		}
-	}
-
-	for(uint i = 0; i < fNameGlyphs3.size(); i++)
-	{
-		for(uint j = 0; j < fNameGlyphs3[i].contours.size(); j++)
-		{
-			for(uint k = 0; k < fNameGlyphs3[i].contours[j].size(); k++)
-			{	
-				degrees3.push_back(fNameGlyphs3[i].contours[j][k].degree);
-			}
-		}
-	}
-	//brown fox
-	for(uint i = 0; i < bf.size(); i++)
-	{
-		for(uint j = 0; j < bf[i].contours.size(); j++)
-		{
-			for(uint k = 0; k < bf[i].contours[j].size(); k++)
-			{	
-				degrees4.push_back(bf[i].contours[j][k].degree);
-			}
-		}
-	}
-	
-	for(uint i = 0; i < bf2.size(); i++)
-	{
-		for(uint j = 0; j < bf2[i].contours.size(); j++)
-		{
-			for(uint k = 0; k < bf2[i].contours[j].size(); k++)
-			{	
-				degrees5.push_back(bf2[i].contours[j][k].degree);
-			}
-		}
-	}
-	
-	for(uint i = 0; i < bf3.size(); i++)
+	// each face falls back on Lora, then SourceSansPro, then Inconsolata for
+	// characters it has no glyph for
+	GlyphExtractor *fallbacks[3] = { ge, ge2, ge3 };
+	GlyphExtractor *primaries[4] = { ge, ge2, ge3, ge4 };
+	MyFontStack stacks[4];
+	for(int i = 0; i < 4; i++)
 	{
-		for(uint j = 0; j < bf3[i].contours.size(); j++)
-		{
-			for(uint k = 0; k < bf3[i].contours[j].size(); k++)
-			{	
-				degrees6.push_back(bf3[i].contours[j][k].degree);
-			}
-		}
+		AddFace(&stacks[i], primaries[i]);
+		for(int j = 0; j < 3; j++)
+			if(fallbacks[j] != primaries[i])
+				AddFace(&stacks[i], fallbacks[j]);
 	}
 
+	// lay out each string, sharing the outlines of glyphs that repeat
+	// within a run or across runs set in the same face
+	MyOutlineStore outlines;
+	MyTextRun runs[6];
+	MyFontStack *runStacks[6] = { &stacks[0], &stacks[1], &stacks[2], &stacks[3], &stacks[2], &stacks[1] };
+	const vector<int> *runText[6] = { &fName, &fName, &fName, &bfString, &bfString, &bfString };
+	AddOutlines(&outlines, runStacks, runText, 6);
+	cout << "Glyph staging used at most " << ArenaPeak(&layoutArena) / 1024 << " KB of "
+	     << ArenaReserved(&layoutArena) / 1024 << " KB reserved" << endl;
+	for(int i = 0; i < 6; i++)
+		LayoutTextRun(&runs[i], &outlines, runStacks[i], *runText[i]);
+	cout << "Layout used at most " << ArenaPeak(&layoutArena) / 1024 << " KB of "
+	     << ArenaReserved(&layoutArena) / 1024 << " KB reserved" << endl;
 
     // call function to create and fill buffers with geometry data
-    MyGeometry geometry, glyphGeometry;
+    MyGeometry geometry;
     if (!InitializeGeometry(&geometry))
         cout << "Program failed to intialize geometry!" << endl;
+
+    // upload the shared outlines and the instances of every run once
+    if (!InitializeOutlineStore(&outlines))
+        cout << "Program failed to intialize geometry!" << endl;
+
+    // draw commands are rebuilt each frame for whichever runs are visible
+    MyCommandBuffer commands;
+    GLint glMajor = 0, glMinor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &glMajor);
+    glGetIntegerv(GL_MINOR_VERSION, &glMinor);
+#ifdef GL_VERSION_4_3
+    hasMultiDrawIndirect = glMajor > 4 || (glMajor == 4 && glMinor >= 3);
+#endif
+#ifdef GL_VERSION_4_4
+    hasBufferStorage = glMajor > 4 || (glMajor == 4 && glMinor >= 4)
+                       || glfwExtensionSupported("GL_ARB_buffer_storage");
+#endif
+    if (!InitializeCommandBuffer(&commands, runs, 6))
+        cout << "Program failed to intialize geometry!" << endl;
+
+    // animations are stepped by elapsed time and paced by the display
+    MyAnimationClock clock;
+    clock.period = refreshPeriod;
+
+    // key presses waiting for the frame that shows them
+    MyLatencyStats latency;
+
     // run an event-triggered main loop
-    while (!glfwWindowShouldClose(window))
+    MyTextRun *visible[6];
+    int visibleCount = 0;
+    MySelection selection;
+    MyFlatCache flatOutlines;
+    bool running = true;
+    while (running)
     {        
-        
-        RenderLineScene(&geometry, &lineShader);
-        
-        RenderScene(&geometry, &shader);
-        
-        if(font == 1)
-        {
-			if(scene == 3)
-			{
-				if (!InitializeGlyphGeometry(&glyphGeometry, fNameGlyphs))
-					cout << "Program failed to intialize geometry!" << endl;
-					
-				RenderGlyphs(&glyphGeometry, &shader, &degrees);
-			
-				RenderGlyphLine(&glyphGeometry, &lineShader, &degrees);
-			}
-		}
-        if(font == 2)
-        {
-			if(scene == 3)
-			{
-				if (!InitializeGlyphGeometry(&glyphGeometry, fNameGlyphs2))
-					cout << "Program failed to intialize geometry!" << endl;
-					
-				RenderGlyphs(&glyphGeometry, &shader, &degrees2);
-			
-				RenderGlyphLine(&glyphGeometry, &lineShader, &degrees2);				
-			}
+        // nothing from the last frame's scratch is still in use
+        ResetArena(&frameArena);
 
-		}
-        if(font == 3)
+        // take in everything that happened since the last frame
+        MyInputEvent event;
+        while (PopInput(&inputQueue, &event))
         {
-			if(scene == 3)
-			{
-				if (!InitializeGlyphGeometry(&glyphGeometry, fNameGlyphs3))
-					cout << "Program failed to intialize geometry!" << endl;
-					
-				RenderGlyphs(&glyphGeometry, &shader, &degrees3);
-			
-				RenderGlyphLine(&glyphGeometry, &lineShader, &degrees3);				
-			}
-		}
-        if(moreFont == 1)
+            if (event.type == INPUT_CLOSE)
+                running = false;
+            else if (event.type == INPUT_MOUSE)
+                SelectGlyphs(&selection, &flatOutlines, ShownRun(runs), event, EmPixels());
+            else
+            {
+                ApplyInput(event);
+                if (MEASURE_LATENCY) TrackLatency(&latency, event);
+            }
+        }
+        if (!running)
+            break;
+
+        // the marquee is stepped first, since how far it has scrolled decides
+        // which of its glyphs are in view
+        unsigned int frame = dirty;
+        dirty = 0;
+        if (frame & DIRTY_FRAME)
         {
-			if(scene == 4)
-			{
-				if (!InitializeGlyphGeometry(&glyphGeometry, bf))
-					cout << "Program failed to intialize geometry!" << endl;
-					
-				RenderGlyphs(&glyphGeometry, &shader, &degrees4);
-			}
-		}
-        if(moreFont == 2)
+            if(scene == 4)
+            {
+                UpdateScroll(ShownRun(runs), &clock);
+                frame |= DIRTY_COMMANDS;
+            }
+            else
+                StopClock(&clock);
+        }
+
+        if (frame & DIRTY_COMMANDS)
         {
-			if(scene == 4)
-			{
-				if (!InitializeGlyphGeometry(&glyphGeometry, bf2))
-					cout << "Program failed to intialize geometry!" << endl;
-					
-				RenderGlyphs(&glyphGeometry, &shader, &degrees5);
-			}
-		}
-        if(moreFont == 3)
+            // collect the glyph runs visible in this scene
+            visibleCount = 0;
+            if(ShownRun(runs))
+                visible[visibleCount++] = ShownRun(runs);
+
+            // one submission per pass covers every visible run
+            BuildCommands(&commands, &outlines, visible, visibleCount, DetailLevel(), RunView());
+        }
+
+        if (frame & DIRTY_FRAME)
         {
-			if(scene == 4)
-			{
-				if (!InitializeGlyphGeometry(&glyphGeometry, bf3))
-					cout << "Program failed to intialize geometry!" << endl;
-					
-				RenderGlyphs(&glyphGeometry, &shader, &degrees6);
-			}
-		}
-		
-		
-			           
-        // scene is rendered to the back buffer, so swap to front for display
-        glfwSwapBuffers(window);
-
-        // sleep until next event before drawing again
-        //glfwWaitEvents();
-        glfwPollEvents();
-        //glfwGetTime(); //grabs clock
+            UpdateFrameUniforms(&uniforms);
+
+            RenderLineScene(&geometry, &shaders);
+            
+            RenderScene(&geometry, &shaders);
+            
+            if (filled == 1)
+                RenderGlyphFill(&commands, &outlines, &shaders);
+            else
+                RenderGlyphs(&commands, &outlines, &shaders);
+
+            FenceCommands(&commands);
+
+            if(scene == 3)
+                RenderGlyphLine(visible[0], &outlines, &shaders);
+
+            // scene is rendered to the back buffer, so swap to front for display
+            glfwSwapBuffers(window);
+            if (MEASURE_LATENCY) RecordLatency(&latency);
+        }
+
+        // keep drawing while something animates, otherwise sleep until the
+        // next event before drawing again
+        if (!dirty)
+            WaitForInput(&inputQueue);
     }
 
+    if (MEASURE_LATENCY) WriteLatency(&latency, latencyPath);
+
+    cout << "Frame scratch used at most " << ArenaPeak(&frameArena) / 1024 << " KB of "
+         << ArenaReserved(&frameArena) / 1024 << " KB reserved" << endl;
+    if (clock.frames > 0)
+        cout << "Animated " << clock.frames << " frames, dropped " << clock.dropped << endl;
+    if (flatOutlines.hits + flatOutlines.misses > 0)
+        cout << "Flattened outlines: " << flatOutlines.hits << " hits, " << flatOutlines.misses
+             << " misses, " << flatOutlines.evictions << " evicted, " << flatOutlines.used / 1024
+             << " KB of " << flatOutlines.budget / 1024 << " KB held" << endl;
+
     // clean up allocated resources before exit
     DestroyGeometry(&geometry);
-    DestroyGeometry(&glyphGeometry);
-    DestroyShaders(&shader);
-    DestroyLineShaders(&lineShader);
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    DestroyCommandBuffer(&commands);
+    DestroyOutlineStore(&outlines);
+    DestroyFrameUniforms(&uniforms);
+    DestroyShaderCache(&shaders);
+    delete ge;
+    delete ge2;
+    delete ge3;
+    delete ge4;
+    glfwMakeContextCurrent(0);
 
-    cout << "Goodbye!" << endl;
     return 0;
 }
 
@@ -1044,7 +2530,9 @@ GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader, GLuint tessContro
     if (tessEvalShader) glAttachShader(programObject, tessEvalShader);
     //***attach tessellation shaders
 
-    // try linking the program with given attachments
+    // try linking the program with given attachments, keeping the binary
+    // retrievable for the program cache
+    glProgramParameteri(programObject, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(programObject);
 
     // retrieve link status
@@ -1072,7 +2560,9 @@ GLuint LinkLineProgram(GLuint vertexShader, GLuint fragmentShader)
     if (vertexShader)   glAttachShader(programObject, vertexShader);
     if (fragmentShader) glAttachShader(programObject, fragmentShader);
 
-    // try linking the program with given attachments
+    // try linking the program with given attachments, keeping the binary
+    // retrievable for the program cache
+    glProgramParameteri(programObject, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(programObject);
 
     // retrieve link status
@@ -1091,4 +2581,83 @@ GLuint LinkLineProgram(GLuint vertexShader, GLuint fragmentShader)
     return programObject;
 }
 
+// returns the file name, within the program cache, of the program built from
+// the given source text by this renderer and driver version
+string ProgramCacheKey(const string &sources)
+{
+    const char *renderer = reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+    const char *version = reinterpret_cast<const char *>(glGetString(GL_VERSION));
+    string text = sources + '\0' + (renderer ? renderer : "") + '\0' + (version ? version : "");
+
+    // 64-bit FNV-1a
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+
+    ostringstream name;
+    name << hex << hash << ".bin";
+    return name.str();
+}
+
+// returns a program object restored from a cached binary, or zero if there is
+// none or the driver no longer accepts it
+GLuint LoadProgramBinary(const string &key)
+{
+    ifstream input((programCachePath + key).c_str(), ios::binary);
+    if (!input) return 0;
+
+    GLenum format = 0;
+    if (!input.read(reinterpret_cast<char *>(&format), sizeof(format))) return 0;
+    string binary((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+    if (binary.empty()) return 0;
+
+    // a binary from another driver may use a format this one cannot read
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    vector<GLint> formats(formatCount + 1);
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, &formats[0]);
+    if (find(formats.begin(), formats.begin() + formatCount, GLint(format)) == formats.begin() + formatCount)
+        return 0;
+
+    GLuint programObject = glCreateProgram();
+    glProgramBinary(programObject, format, binary.data(), binary.size());
+
+    // the driver rejects stale binaries by failing the link status
+    GLint status;
+    glGetProgramiv(programObject, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE)
+    {
+        glDeleteProgram(programObject);
+        return 0;
+    }
+
+    return programObject;
+}
+
+// writes the binary of a linked program to the program cache
+void SaveProgramBinary(GLuint program, const string &key)
+{
+    GLint status = GL_FALSE, length = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (status == GL_FALSE || length <= 0) return;
+
+    string binary(length, '\0');
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, &binary[0]);
+
+    mkdir(programCachePath.c_str(), 0755);
+    ofstream output((programCachePath + key).c_str(), ios::binary);
+    if (!output)
+    {
+        cout << "ERROR: Could not write program binary to " << programCachePath << endl;
+        return;
+    }
+    output.write(reinterpret_cast<const char *>(&format), sizeof(format));
+    output.write(binary.data(), length);
+}
+
 // ==========================================================================
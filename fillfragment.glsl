@@ -0,0 +1,30 @@
+// ==========================================================================
+// Fragment program for stencil-then-cover glyph fill
+// ==========================================================================
+#version 410
+
+// (u,v) for quadratic triangles, (k,l,m) for cubic triangles
+in vec3 curve;
+flat in int degree;
+
+// state shared by every program, uploaded once per frame by the main program
+layout(std140) uniform FrameState
+{
+    vec4  colour;
+    vec2  offset;
+    float tessLevel;
+};
+
+// first output is mapped to the framebuffer's colour index by default
+out vec4 FragmentColour;
+
+void main(void)
+{
+    // keep only the side of each curve that lies between it and its chord
+    if (degree == 2 && curve.x*curve.x - curve.y > 0.0)
+        discard;
+    if (degree == 3 && curve.x*curve.x*curve.x - curve.y*curve.z > 0.0)
+        discard;
+
+    FragmentColour = vec4(colour.rgb, 0);
+}
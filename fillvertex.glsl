@@ -0,0 +1,56 @@
+// ==========================================================================
+// Vertex program for stencil-then-cover glyph fill
+// ==========================================================================
+#version 410
+
+// location indices for these attributes correspond to those specified in the
+// InitializeOutlineStore() function of the main program
+layout(location = 0) in vec2 VertexPosition;
+layout(location = 1) in vec4 CurveCoord;
+layout(location = 2) in vec2 InstancePen;
+
+// curve coordinates and degree passed through to the fragment stage
+out vec3 curve;
+flat out int degree;
+
+// state shared by every program, uploaded once per frame by the main program
+layout(std140) uniform FrameState
+{
+    vec4  colour;
+    vec2  offset;
+    float tessLevel;
+};
+
+// the program is specialised for one scene: SCENE is defined by the main
+// program when it compiles each variant
+#if SCENE == 3
+const mat4 scaMatrix = mat4(0.55,0,0,0,
+					0, 0.55,0,0,
+					0,0,1,0,
+					0,0,0,1);
+
+const mat4 traMatrix = mat4(1,0,0,0,
+					  0,1,0,0,
+					  0,0,1,0,
+					  -0.8,0.0,0,1);
+#else
+const mat4 scaMatrix = mat4(0.9,0,0,0,
+					0, 0.9,0,0,
+					0,0,1,0,
+					0,0,0,1);
+
+const mat4 traMatrix = mat4(1,0,0,0,
+					  0,1,0,0,
+					  0,0,1,0,
+					  0,0,0,1);
+#endif
+
+void main()
+{
+    // place the glyph instance at its pen position, shifted by the scroll
+    vec2 position = VertexPosition + InstancePen + offset;
+    gl_Position = traMatrix * scaMatrix * vec4(position, 0.0, 1.0);
+
+    curve = CurveCoord.xyz;
+    degree = int(CurveCoord.w + 0.5);
+}
@@ -1,19 +1,24 @@
-// ==========================================================================
-// Vertex program for barebones GLFW boilerplate
-//
-// Author:  Sonny Chan, University of Calgary
-// Date:    December 2015
-// ==========================================================================
-#version 410
-
-// interpolated colour received from vertex stage
-in vec3 color;
-
-// first output is mapped to the framebuffer's colour index by default
-out vec4 FragmentColour;
-
-void main(void)
-{
-    // write colour output without modification
-    FragmentColour = vec4(color, 0);
-}
+// ==========================================================================
+// Vertex program for barebones GLFW boilerplate
+//
+// Author:  Sonny Chan, University of Calgary
+// Date:    December 2015
+// ==========================================================================
+#version 410
+
+// state shared by every program, uploaded once per frame by the main program
+layout(std140) uniform FrameState
+{
+    vec4  colour;
+    vec2  offset;
+    float tessLevel;
+};
+
+// first output is mapped to the framebuffer's colour index by default
+out vec4 FragmentColour;
+
+void main(void)
+{
+    // write colour output without modification
+    FragmentColour = vec4(colour.rgb, 0);
+}
@@ -1,15 +1,21 @@
-#version 410
-
-layout (vertices = 4) out;
-
-in vec3 ve_color[];
-
-out vec3 te_color[];
-
-void main()
-{	
-	gl_TessLevelOuter[0] = 1;
-	gl_TessLevelOuter[1] = 32;
-	gl_out[gl_InvocationID].gl_Position = gl_in[gl_InvocationID].gl_Position;
-	te_color[gl_InvocationID] = ve_color[gl_InvocationID];
-}
+#version 410
+
+// the program is specialised for one curve degree: DEGREE is defined by the
+// main program, and each patch holds the DEGREE + 1 control points of one
+// segment
+layout (vertices = DEGREE + 1) out;
+
+// state shared by every program, uploaded once per frame by the main program
+layout(std140) uniform FrameState
+{
+    vec4  colour;
+    vec2  offset;
+    float tessLevel;
+};
+
+void main()
+{	
+	gl_TessLevelOuter[0] = 1;
+	gl_TessLevelOuter[1] = tessLevel;
+	gl_out[gl_InvocationID].gl_Position = gl_in[gl_InvocationID].gl_Position;
+}
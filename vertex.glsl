@@ -1,62 +1,63 @@
-// ==========================================================================
-// Vertex program for barebones GLFW boilerplate
-//
-// Author:  Sonny Chan, University of Calgary
-// Date:    December 2015
-// ==========================================================================
-#version 410
-
-// location indices for these attributes correspond to those specified in the
-// InitializeGeometry() function of the main program
-layout(location = 0) in vec2 VertexPosition;
-layout(location = 1) in vec3 VertexColour;
-
-// output to be interpolated between vertices and passed to the fragment stage
-out vec3 ve_color;
-
-uniform int scene;
-
-void main()
-{
-	mat4 scaMatrix = mat4(0.9,0,0,0,
-					0, 0.9,0,0,
-					0,0,1,0,
-					0,0,0,1);
-									
-	mat4 traMatrix = mat4(1,0,0,0,
-					  0,1,0,0,
-					  0,0,1,0,
-					  0,0,0,1);
-					  
-	if(scene == 2)
-	{
-		scaMatrix = mat4(1.4,0,0,0,
-					0, 1.4,0,0,
-					0,0,1,0,
-					0,0,0,1);
-		
-		traMatrix = mat4(1,0,0,0,
-					  0,1,0,0,
-					  0,0,1,0,
-					  -0.7,-0.3,0,1);	
-	}		
-	if(scene == 3)
-	{
-		scaMatrix = mat4(0.55,0,0,0,
-					0, 0.55,0,0,
-					0,0,1,0,
-					0,0,0,1);
-					
-		traMatrix = mat4(1,0,0,0,
-					  0,1,0,0,
-					  0,0,1,0,
-					  -0.8,0.0,0,1);	
-	}
-
-	
-    // assign vertex position without modification
-    gl_Position = traMatrix * scaMatrix * vec4(VertexPosition, 0.0, 1.0);
-
-    // assign output colour to be interpolated
-    ve_color = VertexColour;
-}
+// ==========================================================================
+// Vertex program for barebones GLFW boilerplate
+//
+// Author:  Sonny Chan, University of Calgary
+// Date:    December 2015
+// ==========================================================================
+#version 410
+
+// location indices for these attributes correspond to those specified in the
+// InitializeGeometry() and InitializeOutlineStore() functions of the main program
+layout(location = 0) in ivec2 VertexPosition;
+layout(location = 1) in vec3 Instance;
+
+// state shared by every program, uploaded once per frame by the main program;
+// offset scrolls the whole run, while each glyph instance carries its own pen
+// position and the scale from packed half font units to the EM units of its face
+layout(std140) uniform FrameState
+{
+    vec4  colour;
+    vec2  offset;
+    float tessLevel;
+};
+
+// the program is specialised for one scene: SCENE is defined by the main
+// program when it compiles each variant
+#if SCENE == 2
+const mat4 scaMatrix = mat4(1.4,0,0,0,
+					0, 1.4,0,0,
+					0,0,1,0,
+					0,0,0,1);
+		
+const mat4 traMatrix = mat4(1,0,0,0,
+					  0,1,0,0,
+					  0,0,1,0,
+					  -0.7,-0.3,0,1);	
+#elif SCENE == 3
+const mat4 scaMatrix = mat4(0.55,0,0,0,
+					0, 0.55,0,0,
+					0,0,1,0,
+					0,0,0,1);
+					
+const mat4 traMatrix = mat4(1,0,0,0,
+					  0,1,0,0,
+					  0,0,1,0,
+					  -0.8,0.0,0,1);	
+#else
+const mat4 scaMatrix = mat4(0.9,0,0,0,
+					0, 0.9,0,0,
+					0,0,1,0,
+					0,0,0,1);
+									
+const mat4 traMatrix = mat4(1,0,0,0,
+					  0,1,0,0,
+					  0,0,1,0,
+					  0,0,0,1);
+#endif
+
+void main()
+{
+    // drop the degree bits and place the point in EM units
+    vec2 position = vec2(VertexPosition >> 1) * Instance.z + Instance.xy + offset;
+    gl_Position = traMatrix * scaMatrix * vec4(position, 0.0, 1.0);
+}